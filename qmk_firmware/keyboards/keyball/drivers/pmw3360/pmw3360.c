@@ -26,13 +26,320 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define PMW3360_SPI_DIVISOR (F_CPU / PMW3360_CLOCKS)
 #define PMW3360_CLOCKS 2000000
 
-static bool motion_bursting = false;
+static const pin_t ncs_pins[] = PMW3360_NCS_PINS;
+
+_Static_assert(sizeof(ncs_pins) / sizeof(ncs_pins[0]) == PMW3360_COUNT, "PMW3360_NCS_PINS must have PMW3360_COUNT pins");
+
+#ifdef PMW3360_MOTION_PINS
+static const pin_t motion_pins[] = PMW3360_MOTION_PINS;
+
+_Static_assert(sizeof(motion_pins) / sizeof(motion_pins[0]) == PMW3360_COUNT, "PMW3360_MOTION_PINS must have PMW3360_COUNT pins");
+#endif
+
+// selected is an index of the module which operations are sent to.
+static uint8_t selected = 0;
+
+// motion_bursting is tracked for each module, because each module enters
+// and leaves motion burst mode by itself.
+static bool motion_bursting[PMW3360_COUNT] = {0};
+
+static bool spi_start_dev(uint8_t dev) {
+    return spi_start(ncs_pins[dev], false, PMW3360_SPI_MODE, PMW3360_SPI_DIVISOR);
+}
 
 bool pmw3360_spi_start(void) {
-    return spi_start(PMW3360_NCS_PIN, false, PMW3360_SPI_MODE, PMW3360_SPI_DIVISOR);
+    return spi_start_dev(selected);
+}
+
+void pmw3360_select(uint8_t dev) {
+    if (dev < PMW3360_COUNT) {
+        selected = dev;
+    }
+}
+
+uint8_t pmw3360_selected(void) {
+    return selected;
+}
+
+static uint32_t pmw3360_timer      = 0;
+static uint32_t pmw3360_scan_count = 0;
+static uint32_t pmw3360_last_count = 0;
+
+void pmw3360_scan_perf_task(void) {
+    pmw3360_scan_count++;
+    uint32_t now = timer_read32();
+    if (TIMER_DIFF_32(now, pmw3360_timer) > 1000) {
+#if defined(CONSOLE_ENABLE)
+        dprintf("pmw3360 scan frequency: %lu\n", pmw3360_scan_count);
+#endif
+        pmw3360_last_count = pmw3360_scan_count;
+        pmw3360_scan_count = 0;
+        pmw3360_timer      = now;
+    }
+}
+
+uint32_t pmw3360_scan_rate_get(void) {
+    return pmw3360_last_count;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Asynchronous operations
+
+#ifdef PMW3360_ASYNC_ENABLE
+
+#    if !defined(__AVR__)
+#        error PMW3360_ASYNC_ENABLE is supported only on AVR
+#    endif
+
+#    if (PMW3360_ASYNC_QUEUE_SIZE & (PMW3360_ASYNC_QUEUE_SIZE - 1)) != 0
+#        error PMW3360_ASYNC_QUEUE_SIZE must be power of 2
+#    endif
+
+#    define ASYNC_QUEUE_MASK (PMW3360_ASYNC_QUEUE_SIZE - 1)
+
+// Timer1 runs with 1/8 prescaler, so it counts 2 ticks per microsecond at
+// 16MHz.
+#    define ASYNC_TICKS_PER_US (F_CPU / 8 / 1000000)
+
+typedef enum {
+    ASYNC_KIND_READ,
+    ASYNC_KIND_WRITE,
+    ASYNC_KIND_BURST,
+} async_kind_t;
+
+typedef enum {
+    ASYNC_IDLE,      // no operations are running.
+    ASYNC_ADDR,      // sending an address byte.
+    ASYNC_ADDR_WAIT, // waiting tSRAD or tSRAD_MOTBR after an address byte.
+    ASYNC_DATA,      // sending or receiving data bytes.
+    ASYNC_HOLD,      // waiting tSCLK-NCS before releasing NCS.
+    ASYNC_GAP,       // waiting tSWW, tSRW or tBEXIT after releasing NCS.
+} async_phase_t;
+
+typedef struct {
+    uint8_t            kind;
+    uint8_t            dev; // index of the module, selected when queued.
+    uint8_t            addr;
+    uint8_t            data;
+    uint8_t            skip; // count of leading bytes to be discarded.
+    uint8_t            len;  // count of bytes to be received, including skip.
+    uint8_t           *buf;
+    pmw3360_async_cb_t cb;
+    void              *arg;
+} async_op_t;
+
+static async_op_t async_queue[PMW3360_ASYNC_QUEUE_SIZE];
+
+// async_head points the oldest operation which is completed but not notified
+// yet.  async_run points the operation which is running (or to be run next).
+// async_tail points a free slot.
+static volatile uint8_t async_head  = 0;
+static volatile uint8_t async_run   = 0;
+static volatile uint8_t async_tail  = 0;
+static volatile uint8_t async_phase = ASYNC_IDLE;
+static uint8_t          async_pos   = 0;
+
+static void async_timer_start(uint16_t us) {
+    TCCR1B = 0;
+    TCNT1  = 0;
+    OCR1A  = us * ASYNC_TICKS_PER_US;
+    TIFR1  = _BV(OCF1A);
+    TIMSK1 |= _BV(OCIE1A);
+    TCCR1B = _BV(WGM12) | _BV(CS11); // CTC mode, clk/8
+}
+
+static void async_timer_stop(void) {
+    TCCR1B = 0;
+    TIMSK1 &= ~_BV(OCIE1A);
+}
+
+// async_begin starts the next queued operation, or becomes idle.
+// This must be called with interrupts disabled.
+static void async_begin(void) {
+    if (async_run == async_tail) {
+        async_phase = ASYNC_IDLE;
+        return;
+    }
+    async_op_t *op = &async_queue[async_run & ASYNC_QUEUE_MASK];
+    spi_start_dev(op->dev);
+    SPCR |= _BV(SPIE);
+    async_pos   = 0;
+    async_phase = ASYNC_ADDR;
+    SPDR        = op->kind == ASYNC_KIND_WRITE ? (op->addr | 0x80) : (op->addr & 0x7f);
+}
+
+// async_end releases NCS, completes the running operation, and waits gap_us
+// before starting the next one.
+static void async_end(uint16_t gap_us) {
+    SPCR &= ~_BV(SPIE);
+    spi_stop();
+    async_run++;
+    async_phase = ASYNC_GAP;
+    async_timer_start(gap_us);
 }
 
+ISR(SPI_STC_vect) {
+    async_op_t *op = &async_queue[async_run & ASYNC_QUEUE_MASK];
+    switch (async_phase) {
+        case ASYNC_ADDR:
+            if (op->kind == ASYNC_KIND_WRITE) {
+                async_phase = ASYNC_DATA;
+                SPDR        = op->data;
+            } else {
+                async_phase = ASYNC_ADDR_WAIT;
+                async_timer_start(op->kind == ASYNC_KIND_READ ? 160 : 35);
+            }
+            break;
+
+        case ASYNC_DATA:
+            if (op->kind == ASYNC_KIND_WRITE) {
+                async_phase = ASYNC_HOLD;
+                async_timer_start(35);
+                break;
+            }
+            if (async_pos >= op->skip) {
+                op->buf[async_pos - op->skip] = SPDR;
+            }
+            if (++async_pos < op->len) {
+                SPDR = 0;
+                break;
+            }
+            async_end(op->kind == ASYNC_KIND_READ ? 20 : 1);
+            break;
+
+        default:
+            break;
+    }
+}
+
+ISR(TIMER1_COMPA_vect) {
+    async_timer_stop();
+    switch (async_phase) {
+        case ASYNC_ADDR_WAIT:
+            async_phase = ASYNC_DATA;
+            SPDR        = 0;
+            break;
+
+        case ASYNC_HOLD:
+            // Write needs 180us between NCS assertions in total.
+            async_end(145);
+            break;
+
+        case ASYNC_GAP:
+            async_begin();
+            break;
+
+        default:
+            break;
+    }
+}
+
+static bool async_enqueue(async_op_t op) {
+    if ((uint8_t)(async_tail - async_head) >= PMW3360_ASYNC_QUEUE_SIZE) {
+        return false;
+    }
+    op.dev                                     = selected;
+    async_queue[async_tail & ASYNC_QUEUE_MASK] = op;
+    ATOMIC_BLOCK_FORCEON {
+        async_tail++;
+        if (async_phase == ASYNC_IDLE) {
+            async_begin();
+        }
+    }
+    return true;
+}
+
+// async_wait waits until all queued operations are completed.
+static void async_wait(void) {
+    while (async_phase != ASYNC_IDLE) {
+    }
+}
+
+bool pmw3360_reg_read_async(uint8_t addr, uint8_t *data, pmw3360_async_cb_t cb, void *arg) {
+    bool ok = async_enqueue((async_op_t){
+        .kind = ASYNC_KIND_READ,
+        .addr = addr,
+        .len  = 1,
+        .buf  = data,
+        .cb   = cb,
+        .arg  = arg,
+    });
+    // Reset motion_bursting mode as same as pmw3360_reg_read().
+    if (ok && addr != pmw3360_Motion_Burst) {
+        motion_bursting[selected] = false;
+    }
+    return ok;
+}
+
+bool pmw3360_reg_write_async(uint8_t addr, uint8_t data, pmw3360_async_cb_t cb, void *arg) {
+    return async_enqueue((async_op_t){
+        .kind = ASYNC_KIND_WRITE,
+        .addr = addr,
+        .data = data,
+        .cb   = cb,
+        .arg  = arg,
+    });
+}
+
+static bool async_burst(uint8_t skip, uint8_t len, uint8_t *buf, pmw3360_async_cb_t cb, void *arg) {
+#    ifdef DEBUG_PMW3360_SCAN_RATE
+    pmw3360_scan_perf_task();
+#    endif
+    // Start motion burst if motion burst mode is not started.
+    if (!motion_bursting[selected]) {
+        if (!pmw3360_reg_write_async(pmw3360_Motion_Burst, 0, NULL, NULL)) {
+            return false;
+        }
+        motion_bursting[selected] = true;
+    }
+    return async_enqueue((async_op_t){
+        .kind = ASYNC_KIND_BURST,
+        .addr = pmw3360_Motion_Burst,
+        .skip = skip,
+        .len  = skip + len,
+        .buf  = buf,
+        .cb   = cb,
+        .arg  = arg,
+    });
+}
+
+bool pmw3360_motion_burst_async(pmw3360_motion_t *d, pmw3360_async_cb_t cb, void *arg) {
+    // Skip MOT and Observation, then receive Delta_X_L, Delta_X_H, Delta_Y_L
+    // and Delta_Y_H into *d directly.  It depends on little endian.
+    return async_burst(2, sizeof(*d), (uint8_t *)d, cb, arg);
+}
+
+bool pmw3360_motion_burst_ex_async(pmw3360_burst_t *d, pmw3360_async_cb_t cb, void *arg) {
+    return async_burst(0, sizeof(*d), (uint8_t *)d, cb, arg);
+}
+
+bool pmw3360_async_busy(void) {
+    return async_head != async_tail;
+}
+
+void pmw3360_async_task(void) {
+    while (async_head != async_run) {
+        async_op_t *op = &async_queue[async_head & ASYNC_QUEUE_MASK];
+        if (op->cb) {
+            op->cb(op->arg);
+        }
+        async_head++;
+    }
+}
+
+void pmw3360_async_flush(void) {
+    async_wait();
+    pmw3360_async_task();
+}
+
+#else
+
+static inline void async_wait(void) {}
+
+#endif
+
 uint8_t pmw3360_reg_read(uint8_t addr) {
+    async_wait();
     pmw3360_spi_start();
     spi_write(addr & 0x7f);
     wait_us(160);
@@ -43,12 +350,13 @@ uint8_t pmw3360_reg_read(uint8_t addr) {
     // Reset motion_bursting mode if read from a register other than motion
     // burst register.
     if (addr != pmw3360_Motion_Burst) {
-        motion_bursting = false;
+        motion_bursting[selected] = false;
     }
     return data;
 }
 
 void pmw3360_reg_write(uint8_t addr, uint8_t data) {
+    async_wait();
     pmw3360_spi_start();
     spi_write(addr | 0x80);
     spi_write(data);
@@ -68,25 +376,12 @@ void pmw3360_cpi_set(uint8_t cpi) {
     pmw3360_reg_write(pmw3360_Config1, cpi);
 }
 
-static uint32_t pmw3360_timer      = 0;
-static uint32_t pmw3360_scan_count = 0;
-static uint32_t pmw3360_last_count = 0;
-
-void pmw3360_scan_perf_task(void) {
-    pmw3360_scan_count++;
-    uint32_t now = timer_read32();
-    if (TIMER_DIFF_32(now, pmw3360_timer) > 1000) {
-#if defined(CONSOLE_ENABLE)
-        dprintf("pmw3360 scan frequency: %lu\n", pmw3360_scan_count);
+bool pmw3360_motion_pending(void) {
+#ifdef PMW3360_MOTION_PINS
+    return !readPin(motion_pins[selected]);
+#else
+    return true;
 #endif
-        pmw3360_last_count = pmw3360_scan_count;
-        pmw3360_scan_count = 0;
-        pmw3360_timer      = now;
-    }
-}
-
-uint32_t pmw3360_scan_rate_get(void) {
-    return pmw3360_last_count;
 }
 
 bool pmw3360_motion_read(pmw3360_motion_t *d) {
@@ -108,10 +403,11 @@ bool pmw3360_motion_burst(pmw3360_motion_t *d) {
 #ifdef DEBUG_PMW3360_SCAN_RATE
     pmw3360_scan_perf_task();
 #endif
+    async_wait();
     // Start motion burst if motion burst mode is not started.
-    if (!motion_bursting) {
+    if (!motion_bursting[selected]) {
         pmw3360_reg_write(pmw3360_Motion_Burst, 0);
-        motion_bursting = true;
+        motion_bursting[selected] = true;
     }
 
     pmw3360_spi_start();
@@ -129,13 +425,31 @@ bool pmw3360_motion_burst(pmw3360_motion_t *d) {
     return true;
 }
 
-bool pmw3360_init(void) {
-    spi_init();
-    setPinOutput(PMW3360_NCS_PIN);
-    // reboot
+bool pmw3360_motion_burst_ex(pmw3360_burst_t *d) {
+#ifdef DEBUG_PMW3360_SCAN_RATE
+    pmw3360_scan_perf_task();
+#endif
+    async_wait();
+    // Start motion burst if motion burst mode is not started.
+    if (!motion_bursting[selected]) {
+        pmw3360_reg_write(pmw3360_Motion_Burst, 0);
+        motion_bursting[selected] = true;
+    }
+
     pmw3360_spi_start();
-    pmw3360_reg_write(pmw3360_Power_Up_Reset, 0x5a);
-    wait_ms(50);
+    spi_write(pmw3360_Motion_Burst);
+    wait_us(35);
+    // Receive all 12 bytes into *d directly.  It depends on little endian.
+    spi_receive((uint8_t *)d, sizeof(*d));
+    spi_stop();
+    // Required NCS in 500ns after motion burst.
+    wait_us(1);
+    return true;
+}
+
+// probe discards motion registers after power up reset, and checks product ID
+// and revision ID.
+static bool probe(void) {
     // read five registers of motion and discard those values
     pmw3360_reg_read(pmw3360_Motion);
     pmw3360_reg_read(pmw3360_Delta_X_L);
@@ -147,30 +461,163 @@ bool pmw3360_init(void) {
     // check product ID and revision ID
     uint8_t pid = pmw3360_reg_read(pmw3360_Product_ID);
     uint8_t rev = pmw3360_reg_read(pmw3360_Revision_ID);
-    spi_stop();
     return pid == 0x42 && rev == 0x01;
 }
 
+static void setup_pins(void) {
+    spi_init();
+    // Deselect all modules, so that only one module drives MISO.
+    for (uint8_t i = 0; i < PMW3360_COUNT; i++) {
+        setPinOutput(ncs_pins[i]);
+        writePinHigh(ncs_pins[i]);
+#ifdef PMW3360_MOTION_PINS
+        setPinInputHigh(motion_pins[i]);
+#endif
+    }
+}
+
+bool pmw3360_init(void) {
+    setup_pins();
+    // reboot
+    pmw3360_spi_start();
+    pmw3360_reg_write(pmw3360_Power_Up_Reset, 0x5a);
+    wait_ms(50);
+    bool ok = probe();
+    spi_stop();
+    return ok;
+}
+
 uint8_t pmw3360_srom_id = 0;
 
-void pmw3360_srom_upload(pmw3360_srom_t srom) {
-    pmw3360_reg_write(pmw3360_Config2, 0x00);
-    pmw3360_reg_write(pmw3360_SROM_Enable, 0x1d);
-    wait_us(10);
-    pmw3360_reg_write(pmw3360_SROM_Enable, 0x18);
+uint16_t pmw3360_srom_crc = 0;
 
-    // SROM upload (download for PMW3360) with burst mode
-    pmw3360_spi_start();
-    spi_write(pmw3360_SROM_Load_Burst | 0x80);
-    wait_us(15);
-    for (size_t i = 0; i < srom.len; i++) {
-        spi_write(pgm_read_byte(srom.data + i));
-        wait_us(15);
+//////////////////////////////////////////////////////////////////////////////
+// Background initialization
+
+typedef enum {
+    BOOT_IDLE,
+    BOOT_PROBE,
+    BOOT_SROM_ENABLE,
+    BOOT_SROM_LOAD,
+    BOOT_SROM_ID,
+    BOOT_SROM_CRC,
+    BOOT_READY,
+    BOOT_FAILED,
+} boot_state_t;
+
+static boot_state_t   boot_state = BOOT_IDLE;
+static pmw3360_srom_t boot_srom  = {0}; // a copy, data is NULL if no SROM
+static size_t         boot_pos   = 0;
+static uint16_t       boot_timer = 0;
+static uint16_t       boot_delay = 0;
+static uint8_t        boot_dev   = 0;
+
+// boot_next moves to the next state, which will run after delay_ms.
+static void boot_next(boot_state_t next, uint16_t delay_ms) {
+    boot_state = next;
+    boot_timer = timer_read();
+    boot_delay = delay_ms;
+}
+
+void pmw3360_boot_start(const pmw3360_srom_t *srom, bool reset) {
+    // Copy the descriptor, srom may point to a temporary of the caller.
+    boot_srom = srom != NULL ? *srom : (pmw3360_srom_t){0};
+    boot_pos  = 0;
+    boot_dev  = selected;
+    if (!reset) {
+        boot_next(boot_srom.data != NULL ? BOOT_SROM_ENABLE : BOOT_READY, 0);
+        return;
     }
-    spi_stop();
-    wait_us(200);
+    setup_pins();
+    pmw3360_reg_write(pmw3360_Power_Up_Reset, 0x5a);
+    boot_next(BOOT_PROBE, 50);
+}
 
-    pmw3360_srom_id = pmw3360_reg_read(pmw3360_SROM_ID);
-    pmw3360_reg_write(pmw3360_Config2, 0x00);
-    wait_ms(10);
+static pmw3360_boot_status_t boot_step(void) {
+    if (boot_delay > 0) {
+        if (timer_elapsed(boot_timer) < boot_delay) {
+            return PMW3360_BOOT_PENDING;
+        }
+        boot_delay = 0;
+    }
+    switch (boot_state) {
+        case BOOT_PROBE:
+            if (!probe()) {
+                boot_next(BOOT_FAILED, 0);
+                break;
+            }
+            boot_next(boot_srom.data != NULL ? BOOT_SROM_ENABLE : BOOT_READY, 0);
+            break;
+
+        case BOOT_SROM_ENABLE:
+            pmw3360_reg_write(pmw3360_Config2, 0x00);
+            pmw3360_reg_write(pmw3360_SROM_Enable, 0x1d);
+            wait_us(10);
+            pmw3360_reg_write(pmw3360_SROM_Enable, 0x18);
+            // NCS is kept low until whole SROM is sent, over some calls.
+            pmw3360_spi_start();
+            spi_write(pmw3360_SROM_Load_Burst | 0x80);
+            wait_us(15);
+            boot_next(BOOT_SROM_LOAD, 0);
+            break;
+
+        case BOOT_SROM_LOAD: {
+            size_t end = boot_pos + PMW3360_SROM_UPLOAD_CHUNK;
+            if (end > boot_srom.len) {
+                end = boot_srom.len;
+            }
+            for (; boot_pos < end; boot_pos++) {
+                spi_write(pgm_read_byte(boot_srom.data + boot_pos));
+                wait_us(15);
+            }
+            if (boot_pos < boot_srom.len) {
+                break;
+            }
+            spi_stop();
+            // Wait 200us or more before reading SROM_ID.
+            boot_next(BOOT_SROM_ID, 1);
+        } break;
+
+        case BOOT_SROM_ID:
+            pmw3360_srom_id = pmw3360_reg_read(pmw3360_SROM_ID);
+            // Start CRC self-test of SROM, it takes 10ms.
+            pmw3360_reg_write(pmw3360_SROM_Enable, 0x15);
+            boot_next(BOOT_SROM_CRC, 10);
+            break;
+
+        case BOOT_SROM_CRC:
+            pmw3360_srom_crc = pmw3360_reg_read(pmw3360_Data_Out_Lower);
+            pmw3360_srom_crc |= pmw3360_reg_read(pmw3360_Data_Out_Upper) << 8;
+            if (pmw3360_srom_crc != PMW3360_SROM_CRC_OK) {
+                pmw3360_srom_id = 0;
+            }
+            pmw3360_reg_write(pmw3360_Config2, 0x00);
+            boot_next(BOOT_READY, 10);
+            break;
+
+        case BOOT_READY:
+            return PMW3360_BOOT_READY;
+
+        case BOOT_IDLE:
+        case BOOT_FAILED:
+            return PMW3360_BOOT_FAILED;
+    }
+    return PMW3360_BOOT_PENDING;
+}
+
+pmw3360_boot_status_t pmw3360_boot_task(void) {
+    // Progress on the module which the initialization was started for, and
+    // restore the selection for the caller.
+    uint8_t               prev = selected;
+    selected                   = boot_dev;
+    pmw3360_boot_status_t st   = boot_step();
+    selected                   = prev;
+    return st;
+}
+
+void pmw3360_srom_upload(pmw3360_srom_t srom) {
+    // Share the uploader with background initialization, to save flash.
+    pmw3360_boot_start(&srom, false);
+    while (pmw3360_boot_task() == PMW3360_BOOT_PENDING) {
+    }
 }
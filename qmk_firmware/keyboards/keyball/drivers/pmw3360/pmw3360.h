@@ -27,12 +27,61 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #    define PMW3360_NCS_PIN B6
 #endif
 
+/// PMW3360_MOTION_PIN specifies a pin which is connected to MOTION output of
+/// PMW3360.  When defined, motion is read only while the pin is low.  The pin
+/// is kept low until motion data is read, so no motion will be missed even if
+/// it is checked in the main loop.
+//#define PMW3360_MOTION_PIN D1
+
+/// PMW3360_COUNT is count of PMW3360 modules which share the SPI bus.  Each
+/// module has its own NCS pin, and an operation is sent to the module which
+/// is selected by pmw3360_select().
+#ifndef PMW3360_COUNT
+#    define PMW3360_COUNT 1
+#endif
+
+/// PMW3360_NCS_PINS lists NCS pins of all modules, in order of device index.
+/// It must have PMW3360_COUNT elements.
+//#define PMW3360_NCS_PINS { B6, B5 }
+#ifndef PMW3360_NCS_PINS
+#    define PMW3360_NCS_PINS \
+        { PMW3360_NCS_PIN }
+#endif
+
+/// PMW3360_MOTION_PINS lists MOTION pins of all modules, in order of device
+/// index.  It must have PMW3360_COUNT elements when defined.
+//#define PMW3360_MOTION_PINS { D1, D0 }
+#if !defined(PMW3360_MOTION_PINS) && defined(PMW3360_MOTION_PIN)
+#    define PMW3360_MOTION_PINS \
+        { PMW3360_MOTION_PIN }
+#endif
+
 /// DEBUG_PMW3360_SCAN_RATE enables scan performance counter.
 /// It records scan count in a last second and enables pmw3360_scan_rate_get().
 /// Additionally, it will be logged automatically when defined CONSOLE_ENABLE
 /// and `debug_enable = true`.
 //#define DEBUG_PMW3360_SCAN_RATE
 
+/// PMW3360_ASYNC_ENABLE enables asynchronous (non-blocking) register and
+/// motion burst operations.  SPI bytes are scheduled from the SPI transfer
+/// complete interrupt and the delays required by PMW3360 (tSRAD, tSWW, tSRW
+/// and so on) are measured by Timer1, so the main loop never spins on them.
+/// This works only on AVR, and Timer1 must not be used by other features
+/// (BACKLIGHT_ENABLE or SLEEP_LED_ENABLE).
+//#define PMW3360_ASYNC_ENABLE
+
+/// PMW3360_ASYNC_QUEUE_SIZE is max number of queued asynchronous operations.
+/// It must be power of 2.
+#ifndef PMW3360_ASYNC_QUEUE_SIZE
+#    define PMW3360_ASYNC_QUEUE_SIZE 4
+#endif
+
+/// PMW3360_SROM_UPLOAD_CHUNK is count of SROM bytes which are sent by each
+/// pmw3360_boot_task() call.  Each byte takes about 16us.
+#ifndef PMW3360_SROM_UPLOAD_CHUNK
+#    define PMW3360_SROM_UPLOAD_CHUNK 64
+#endif
+
 //////////////////////////////////////////////////////////////////////////////
 // Types
 
@@ -46,6 +95,27 @@ typedef struct {
     int16_t y;
 } pmw3360_motion_t;
 
+/// pmw3360_burst_t is whole data of Motion_Burst.  The layout is same as the
+/// order of bytes which Motion_Burst sends, so it is read into directly.
+typedef struct {
+    uint8_t mot; // Motion register: see pmw3360_MOT and pmw3360_Lift_Stat
+    uint8_t observation;
+    int16_t x;
+    int16_t y;
+    uint8_t squal;
+    uint8_t raw_data_sum;
+    uint8_t max_raw_data;
+    uint8_t min_raw_data;
+    uint8_t shutter_upper;
+    uint8_t shutter_lower;
+} pmw3360_burst_t;
+
+typedef enum {
+    PMW3360_BOOT_PENDING = 0,
+    PMW3360_BOOT_READY   = 1,
+    PMW3360_BOOT_FAILED  = 2,
+} pmw3360_boot_status_t;
+
 typedef enum {
     pmw3360_Product_ID                 = 0x00,
     pmw3360_Revision_ID                = 0x01,
@@ -102,12 +172,27 @@ enum {
     pmw3360_MAXCPI = 0x77, // = 119: 12000 CPI
 };
 
+enum {
+    PMW3360_SROM_CRC_OK = 0xBEEF, // result of SROM CRC self-test, when valid
+};
+
+// Bits of Motion register.
+enum {
+    pmw3360_MOT       = 0x80, // motion occurred
+    pmw3360_Lift_Stat = 0x08, // chip is lifted, no motion is reported
+};
+
 //////////////////////////////////////////////////////////////////////////////
 // Exported values (touch carefully)
 
 /// SROM ID, last uploaded. 0 means not uploaded yet.
 extern uint8_t pmw3360_srom_id;
 
+/// Result of SROM CRC self-test, which is done by pmw3360_boot_task() after
+/// uploading.  It is PMW3360_SROM_CRC_OK when SROM is valid, and
+/// pmw3360_srom_id is reset to 0 when not.
+extern uint16_t pmw3360_srom_crc;
+
 /// SROM 0x04
 extern const pmw3360_srom_t pmw3360_srom_0x04;
 /// SROM 0x81
@@ -116,12 +201,44 @@ extern const pmw3360_srom_t pmw3360_srom_0x81;
 //////////////////////////////////////////////////////////////////////////////
 // Top level API
 
+/// pmw3360_select selects a module which following operations are sent to.
+/// dev is an index of PMW3360_NCS_PINS, and the module 0 is selected
+/// initially.  Queued asynchronous operations are kept sent to the module
+/// which was selected when they were queued.
+void pmw3360_select(uint8_t dev);
+
+/// pmw3360_selected returns an index of the selected module.
+uint8_t pmw3360_selected(void);
+
 /// pmw3360_init initializes PMW3360DM-T2QU module.
 /// It will return true when succeeded, otherwise false.
 bool pmw3360_init(void);
 
+/// pmw3360_srom_upload uploads SROM and runs CRC self-test, and waits for
+/// them to be completed.  See pmw3360_boot_task() for non-blocking one.
+/// This requires the timer, so it can't be used in keyboard_pre_init_kb().
 void pmw3360_srom_upload(pmw3360_srom_t srom);
 
+/// pmw3360_boot_start starts initialization of PMW3360 in background.  It
+/// resets the module when reset is true, then uploads srom when it is not
+/// NULL.  Nothing blocks longer than a few milliseconds, so keys can be
+/// scanned while the initialization progresses by pmw3360_boot_task().
+///
+/// Pass false to reset when pmw3360_init() has already been called.
+///
+/// The initialization runs on the module which is selected at this call,
+/// regardless of selection at each pmw3360_boot_task() call.  Don't operate
+/// other modules until it completes, because NCS is kept low while SROM is
+/// uploaded.  pmw3360_srom_id and pmw3360_srom_crc hold results of the last
+/// initialized module.
+void pmw3360_boot_start(const pmw3360_srom_t *srom, bool reset);
+
+/// pmw3360_boot_task progresses the initialization which is started by
+/// pmw3360_boot_start(), and returns its status.  Call this periodically
+/// until it returns other than PMW3360_BOOT_PENDING.  SROM is sent by each
+/// PMW3360_SROM_UPLOAD_CHUNK bytes, and CRC self-test is done after that.
+pmw3360_boot_status_t pmw3360_boot_task(void);
+
 /// pmw3360_motion_read gets a motion data by Motion register.
 /// This requires to write a dummy data to pmw3360_Motion register
 /// just before.
@@ -132,6 +249,16 @@ bool pmw3360_motion_read(pmw3360_motion_t *d);
 /// just before.
 bool pmw3360_motion_burst(pmw3360_motion_t *d);
 
+/// pmw3360_motion_burst_ex gets whole data of Motion_Burst: Motion,
+/// Observation, deltas, SQUAL, Raw_Data_Sum, Maximum_Raw_Data,
+/// Minimum_Raw_Data and Shutter, in a single transaction.
+/// Check pmw3360_Lift_Stat bit of d->mot to know whether deltas are valid.
+bool pmw3360_motion_burst_ex(pmw3360_burst_t *d);
+
+/// pmw3360_motion_pending checks whether PMW3360 has motion data to be read.
+/// It always returns true when PMW3360_MOTION_PINS is not defined.
+bool pmw3360_motion_pending(void);
+
 /// pmw3360_scan_rate_get gets count of scan in a last second.
 /// This works only when DEBUG_PMW3360_SCAN_RATE is defined.
 uint32_t pmw3360_scan_rate_get(void);
@@ -142,6 +269,46 @@ uint8_t pmw3360_cpi_get(void);
 // TODO: document
 void pmw3360_cpi_set(uint8_t cpi);
 
+//////////////////////////////////////////////////////////////////////////////
+// Asynchronous operations
+//
+// These work only when PMW3360_ASYNC_ENABLE is defined.  Operations are
+// queued and executed in order by interrupts.  Blocking APIs above and below
+// wait until all queued operations are completed, so both can be mixed.
+
+/// pmw3360_async_cb_t is a callback to notify completion of an asynchronous
+/// operation.  It is called from pmw3360_async_task(), not from interrupts.
+typedef void (*pmw3360_async_cb_t)(void *arg);
+
+/// pmw3360_reg_read_async queues reading a register to *data.
+/// It returns false when the queue is full.
+bool pmw3360_reg_read_async(uint8_t addr, uint8_t *data, pmw3360_async_cb_t cb, void *arg);
+
+/// pmw3360_reg_write_async queues writing a value to a register.
+/// It returns false when the queue is full.
+bool pmw3360_reg_write_async(uint8_t addr, uint8_t data, pmw3360_async_cb_t cb, void *arg);
+
+/// pmw3360_motion_burst_async queues reading a motion data by Motion_Burst
+/// command.  *d is valid when cb is called.
+/// It returns false when the queue is full.
+bool pmw3360_motion_burst_async(pmw3360_motion_t *d, pmw3360_async_cb_t cb, void *arg);
+
+/// pmw3360_motion_burst_ex_async queues reading whole data of Motion_Burst.
+/// *d is valid when cb is called.
+/// It returns false when the queue is full.
+bool pmw3360_motion_burst_ex_async(pmw3360_burst_t *d, pmw3360_async_cb_t cb, void *arg);
+
+/// pmw3360_async_busy checks whether some operations are queued or running.
+bool pmw3360_async_busy(void);
+
+/// pmw3360_async_task calls callbacks of completed operations.
+/// Call this periodically from the main loop.
+void pmw3360_async_task(void);
+
+/// pmw3360_async_flush waits until all queued operations are completed, and
+/// calls their callbacks.
+void pmw3360_async_flush(void);
+
 //////////////////////////////////////////////////////////////////////////////
 // Register operations
 
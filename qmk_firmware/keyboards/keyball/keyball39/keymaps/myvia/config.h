@@ -38,8 +38,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // Enable 5 layers for VIA dynamic keymaps.
 #define DYNAMIC_KEYMAP_LAYER_COUNT 5
 
-#define SPLIT_TRANSACTION_IDS_USER MYVIA_SET_OLED_INVERSION
-
 #undef  OLED_FONT_H
 #undef  OLED_FONT_START
 #undef  OLED_FONT_END
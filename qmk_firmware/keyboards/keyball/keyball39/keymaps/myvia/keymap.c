@@ -22,7 +22,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include QMK_KEYBOARD_H
 
 #include "quantum.h"
-#include "split_common/transactions.h"
 #include "raw_hid.h"
 #include "usb_descriptor.h"
 #include "os_detection.h"
@@ -74,7 +73,10 @@ typedef union {
 typedef enum {
     OLED_OFF = 0,
     OLED_ON_DEFAULT,
-    OLED_ON_MYVIA_MISC
+    OLED_ON_MYVIA_MISC,
+#ifdef KEYBALL_PROFILE_ENABLE
+    OLED_ON_PROFILE,
+#endif
 } oled_state_t;
 
 typedef struct {
@@ -84,7 +86,6 @@ typedef struct {
     oled_state_t oled_status;
     uint32_t oled_timer;
     bool oled_inversion;
-    bool oled_inversion_changed;
 #endif
 #if defined(RAW_ENABLE) && defined(HID_REPORT_ENABLE)
     uint8_t last_highest_layer;
@@ -604,21 +605,11 @@ layer_state_t layer_state_set_user(layer_state_t state) {
 
 #include "lib/oledkit/oledkit.h"
 
-static void rpc_set_oled_invert_handler(uint8_t in_buflen, const void *in_data, uint8_t out_buflen, void *out_data) {
-    bool oled_inversion = *(bool *)in_data;
-    user_state.oled_inversion = oled_inversion;
-}
-
-static void rpc_set_oled_invert_invoke(void) {
-    if (!user_state.oled_inversion_changed) {
-        return;
-    }
-
-    bool req = user_state.oled_inversion;
-    if (!transaction_rpc_send(MYVIA_SET_OLED_INVERSION, sizeof(req), &req)) {
-        return;
-    }
-    user_state.oled_inversion_changed = false;
+// OLED inversion is mirrored to the secondary by keyball's state sync.
+static void oled_set_inversion(bool inversion) {
+    user_state.oled_inversion = inversion;
+    keyball_set_oled_flags(inversion ? KEYBALL_OLED_INVERTED : 0);
+    oled_invert(inversion);
 }
 
 static const char *format_u3d(uint8_t d) {
@@ -758,6 +749,11 @@ void oled_set_status(oled_state_t state) {
     if (state == OLED_ON_MYVIA_MISC && user_state.oled_status != OLED_ON_MYVIA_MISC) {
         oled_clear();
     }
+#ifdef KEYBALL_PROFILE_ENABLE
+    if (state == OLED_ON_PROFILE && user_state.oled_status != OLED_ON_PROFILE) {
+        oled_clear();
+    }
+#endif
     user_state.oled_status = state;
 }
 
@@ -771,6 +767,11 @@ void oled_toggle_status(void) {
             oled_set_status(OLED_ON_MYVIA_MISC);
             break;
         case OLED_ON_MYVIA_MISC:
+#ifdef KEYBALL_PROFILE_ENABLE
+            oled_set_status(OLED_ON_PROFILE);
+            break;
+        case OLED_ON_PROFILE:
+#endif
             oled_set_status(OLED_OFF);
             break;
         default:
@@ -791,7 +792,7 @@ void oled_sync_inversion(void) {
         return;
     }
 
-    oled_invert(user_state.oled_inversion);
+    oled_invert(keyball_get_oled_flags() & KEYBALL_OLED_INVERTED);
 }
 
 void oledkit_render_info_user(void) {
@@ -806,6 +807,11 @@ void oledkit_render_info_user(void) {
         case OLED_ON_MYVIA_MISC:
             oled_render_myvia_info();
             break;
+#ifdef KEYBALL_PROFILE_ENABLE
+        case OLED_ON_PROFILE:
+            keyball_oled_render_profile();
+            break;
+#endif
         default:
             break;
     }
@@ -832,8 +838,6 @@ void oledkit_render_logo_user(void) {
 
 void keyboard_post_init_user(void) {
 #ifdef OLED_ENABLE
-    transaction_register_rpc(MYVIA_SET_OLED_INVERSION, rpc_set_oled_invert_handler);
-
     // turn on OLED on startup.
     oled_set_status(OLED_ON_DEFAULT);
 #endif
@@ -852,8 +856,7 @@ void keyball_keyboard_post_init_eeconfig_user(uint32_t raw) {
     user_state.auto_mouse_layer_enabled = c.auto_mouse_layer_enabled ? true : false;
 
 #ifdef OLED_ENABLE
-    user_state.oled_inversion = c.oled_inversion ? true : false;
-    oled_invert(user_state.oled_inversion);
+    oled_set_inversion(c.oled_inversion ? true : false);
 #endif
 #if defined(RAW_ENABLE) && defined(HID_REPORT_ENABLE)
     user_state.raw_hid_layer_report_enabled = c.report_layer_state ? true : false;
@@ -909,7 +912,6 @@ void housekeeping_task_user() {
         }
 #endif
 #ifdef OLED_ENABLE
-        rpc_set_oled_invert_invoke();
         if (user_state.oled_status != OLED_OFF) {
             bool should_oled_off = (timer_elapsed32(user_state.oled_timer) > MYVIA_OLED_TIMEOUT);
             if (should_oled_off && is_oled_on()) {
@@ -979,9 +981,7 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
                 oled_toggle_status();
                 break;
             case OL_TGLINV:
-                user_state.oled_inversion = !user_state.oled_inversion;
-                user_state.oled_inversion_changed = true;
-                oled_invert(user_state.oled_inversion);
+                oled_set_inversion(!user_state.oled_inversion);
                 break;
 #endif
             case TAT_I5:
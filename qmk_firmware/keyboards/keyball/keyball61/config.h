@@ -39,7 +39,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // it has been reported to work well in such cases.
 //#define SPLIT_WATCHDOG_ENABLE
 
-#define SPLIT_TRANSACTION_IDS_KB KEYBALL_GET_INFO, KEYBALL_GET_MOTION, KEYBALL_SET_CPI
+#define SPLIT_TRANSACTION_IDS_KB KEYBALL_GET_INFO, KEYBALL_GET_MOTION, KEYBALL_SYNC_STATE
+
+// The duplex matrix carries the motion flag of the secondary's ball out of
+// band.  It has no spare columns, so a position without a key is used.
+#define KEYBALL_MOTION_FLAG_COL 7
 
 // RGB LED settings
 #define WS2812_DI_PIN       D3
@@ -19,6 +19,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "quantum.h"
 #include "matrix.h"
 #include "debounce.h"
+#include "duplexmatrix.h"
+
+#if defined(KEYBALL_PROFILE_ENABLE) || defined(KEYBALL_MOTION_FLAG_COL)
+#    include "lib/keyball/keyball.h"
+#else
+#    define KEYBALL_PROFILE_BEGIN(since)
+#    define KEYBALL_PROFILE_END(phase, since)
+#endif
 
 #ifdef SPLIT_KEYBOARD
 #    include "split_common/split_util.h"
@@ -49,6 +57,164 @@ static void set_pins_input(pin_t* pins, uint8_t n) {
     }
 }
 
+__attribute__((weak)) void duplex_scan_raw_post_kb(matrix_row_t out_matrix[]) {}
+
+matrix_row_t duplex_permute(const duplex_perm_t *perm, matrix_row_t bits) {
+    matrix_row_t r = 0;
+    for (uint8_t i = 0; i < sizeof(*perm) / sizeof((*perm)[0]); i++, bits >>= 4) {
+        const matrix_row_t *p = &(*perm)[i][bits & 0xF];
+#if MATRIX_COLS <= 8
+        r |= pgm_read_byte(p);
+#elif MATRIX_COLS <= 16
+        r |= pgm_read_word(p);
+#else
+        r |= pgm_read_dword(p);
+#endif
+    }
+    return r;
+}
+
+#ifdef __AVR__
+
+#    ifndef MATRIX_IO_DELAY
+#        define MATRIX_IO_DELAY 30
+#    endif
+
+#    define LINE_MAX (PINNUM_ROW > PINNUM_COL ? PINNUM_ROW : PINNUM_COL)
+
+_Static_assert(LINE_MAX <= 8, "duplexmatrix supports up to 8 rows and 8 columns for each hand");
+
+// port_t is a port which some lines of a group are on.
+typedef struct {
+    volatile uint8_t* reg;  // PINx, followed by DDRx and PORTx
+    uint8_t           mask; // bits of all lines on the port
+} port_t;
+
+// line_t is a precomputed register mask of a line.
+typedef struct {
+    uint8_t port; // index of port_t in the group
+    uint8_t mask; // bit of the line on the port
+} line_t;
+
+// group_t is a group of lines, rows or columns.  Reading lines of a group
+// reads each port once, and gathers bits of lines from them.
+typedef struct {
+    uint8_t n_ports;
+    port_t  ports[LINE_MAX];
+    line_t  lines[LINE_MAX];
+} group_t;
+
+static group_t rows = {0};
+static group_t cols = {0};
+
+static void group_init(group_t* g, const pin_t* pins, uint8_t n) {
+    g->n_ports = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        volatile uint8_t* reg  = &PINx_ADDRESS(pins[i]);
+        uint8_t           mask = _BV(pins[i] & 0xF);
+        uint8_t           p    = 0;
+        while (p < g->n_ports && g->ports[p].reg != reg) {
+            p++;
+        }
+        if (p == g->n_ports) {
+            g->ports[p] = (port_t){.reg = reg, .mask = 0};
+            g->n_ports++;
+        }
+        g->ports[p].mask |= mask;
+        g->lines[i] = (line_t){.port = p, .mask = mask};
+    }
+}
+
+// read_lines returns bits of lines which are low, bit 0 for the line 0.
+static uint8_t read_lines(const group_t* g, uint8_t n) {
+    uint8_t v[LINE_MAX];
+    for (uint8_t p = 0; p < g->n_ports; p++) {
+        v[p] = *g->ports[p].reg;
+    }
+    uint8_t bits = 0;
+    uint8_t bit  = 1;
+    for (uint8_t i = 0; i < n; i++, bit <<= 1) {
+        if ((v[g->lines[i].port] & g->lines[i].mask) == 0) {
+            bits |= bit;
+        }
+    }
+    return bits;
+}
+
+static bool group_idle(const group_t* g) {
+    for (uint8_t p = 0; p < g->n_ports; p++) {
+        if ((*g->ports[p].reg & g->ports[p].mask) != g->ports[p].mask) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// select_line drives the line low.  Registers are modified in an atomic
+// block, because they are read-modify-write by a pointer, not by sbi/cbi, and
+// interrupts may modify other bits of the port, e.g. NCS of the sensor.
+static inline void select_line(const group_t* g, uint8_t i) {
+    volatile uint8_t* reg  = g->ports[g->lines[i].port].reg;
+    uint8_t           mask = g->lines[i].mask;
+    ATOMIC_BLOCK_FORCEON {
+        reg[2] &= ~mask; // PORTx: low
+        reg[1] |= mask;  // DDRx: output
+    }
+}
+
+// unselect_line drives the line high before releasing it to the pull-up,
+// so that it needn't wait for the pull-up to charge the line.
+static inline void unselect_line(const group_t* g, uint8_t i) {
+    volatile uint8_t* reg  = g->ports[g->lines[i].port].reg;
+    uint8_t           mask = g->lines[i].mask;
+    ATOMIC_BLOCK_FORCEON {
+        reg[2] |= mask;  // PORTx: high
+        reg[1] &= ~mask; // DDRx: input with pull-up
+    }
+}
+
+// wait_idle waits until all lines are pulled up, instead of the fixed
+// matrix_output_unselect_delay().  It takes MATRIX_IO_DELAY at most, when
+// keys on the unselected line are pressed.
+static void wait_idle(void) {
+    for (uint8_t t = 0; t < MATRIX_IO_DELAY; t++) {
+        if (group_idle(&rows) && group_idle(&cols)) {
+            return;
+        }
+        wait_us(1);
+    }
+}
+
+static void duplex_scan_raw(matrix_row_t out_matrix[]) {
+    // scan column to row
+    for (uint8_t row = 0; row < PINNUM_ROW; row++) {
+        select_line(&rows, row);
+        matrix_output_select_delay();
+        out_matrix[row] |= read_lines(&cols, PINNUM_COL);
+        unselect_line(&rows, row);
+        wait_idle();
+    }
+
+    // scan row to column.
+    for (uint8_t col = 0; col < PINNUM_COL; col++) {
+        select_line(&cols, col);
+        matrix_output_select_delay();
+        uint8_t      bits    = read_lines(&rows, PINNUM_ROW);
+        matrix_row_t shifter = ((matrix_row_t)1) << (col + PINNUM_COL);
+        for (uint8_t row = 0; bits != 0; row++, bits >>= 1) {
+            if (bits & 1) {
+                out_matrix[row] |= shifter;
+            }
+        }
+        unselect_line(&cols, col);
+        wait_idle();
+    }
+
+    duplex_scan_raw_post_kb(out_matrix);
+}
+
+#else
+
 static inline void set_pin_output(pin_t pin) {
     setPinOutput(pin);
     writePinLow(pin);
@@ -58,8 +224,6 @@ static inline bool get_pin(pin_t pin) {
     return readPin(pin);
 }
 
-__attribute__((weak)) void duplex_scan_raw_post_kb(matrix_row_t out_matrix[]) {}
-
 static void duplex_scan_raw(matrix_row_t out_matrix[]) {
     // scan column to row
     for (uint8_t row = 0; row < PINNUM_ROW; row++) {
@@ -91,6 +255,8 @@ static void duplex_scan_raw(matrix_row_t out_matrix[]) {
     duplex_scan_raw_post_kb(out_matrix);
 }
 
+#endif
+
 static bool duplex_scan(matrix_row_t current_matrix[]) {
     bool         changed = false;
     matrix_row_t tmp[MATRIX_ROWS] = {0};
@@ -118,6 +284,10 @@ void matrix_init_custom(void) {
 
     set_pins_input(col_pins, PINNUM_COL);
     set_pins_input(row_pins, PINNUM_ROW);
+#ifdef __AVR__
+    group_init(&rows, row_pins, PINNUM_ROW);
+    group_init(&cols, col_pins, PINNUM_COL);
+#endif
 
 #ifdef SPLIT_KEYBOARD
     thisHand = isLeftHand ? 0 : ROWS_PER_HAND;
@@ -136,39 +306,160 @@ __attribute__((weak)) void matrix_slave_scan_kb(void) {
 
 __attribute__((weak)) void matrix_slave_scan_user(void) {}
 
+__attribute__((weak)) void duplex_slave_send_kb(matrix_row_t rows[]) {}
+
+__attribute__((weak)) void duplex_master_recv_kb(matrix_row_t rows[]) {}
+
 #endif
 
 // declare matrix buffers which defined in quantum/matrix_common.c
 extern matrix_row_t raw_matrix[MATRIX_ROWS];
 extern matrix_row_t matrix[MATRIX_ROWS];
 
-uint8_t matrix_scan(void) {
-    bool changed = duplex_scan(raw_matrix);
+#ifdef DUPLEX_MATRIX_EAGER_DEBOUNCE
+
+#    ifndef DEBOUNCE
+#        define DEBOUNCE 5
+#    endif
+
+#    if DEBOUNCE < 1 || DEBOUNCE > 7
+#        error DUPLEX_MATRIX_EAGER_DEBOUNCE requires DEBOUNCE in 1 to 7.
+#    endif
+
+// Each key has a 3 bits counter of milliseconds until its release, which is
+// bit-sliced into 3 planes of rows.  A key is pending for release while its
+// counter is not zero.  Rows include both directions of the duplex scan.
+static matrix_row_t release_cnt[3][ROWS_PER_HAND] = {0};
+static uint16_t     release_tick                  = 0;
+
+// EAGER_SKIP is bits of a row which aren't keys, and aren't debounced.
+#    ifdef KEYBALL_MOTION_FLAG_COL
+#        define EAGER_SKIP(row) ((row) == KEYBALL_MOTION_FLAG_ROW ? (matrix_row_t)1 << KEYBALL_MOTION_FLAG_COL : 0)
+#    else
+#        define EAGER_SKIP(row) 0
+#    endif
+
+// eager_debounce updates cooked by raw, and tells whether cooked is changed.
+static bool eager_debounce(const matrix_row_t raw[], matrix_row_t cooked[]) {
+    // count elapsed milliseconds, but no more than the counters need.  The
+    // tick follows now even if it is clamped, or it would lag after a long
+    // gap, and later releases would be counted down at once.
+    uint16_t now     = timer_read();
+    uint16_t elapsed = TIMER_DIFF_16(now, release_tick);
+    release_tick     = now;
+    if (elapsed > DEBOUNCE) {
+        elapsed = DEBOUNCE;
+    }
+
+    bool changed = false;
+    for (uint8_t row = 0; row < ROWS_PER_HAND; row++) {
+        matrix_row_t  skip = EAGER_SKIP(row);
+        matrix_row_t  r    = raw[row] & ~skip;
+        matrix_row_t  s    = cooked[row] & ~skip;
+        matrix_row_t* c0   = &release_cnt[0][row];
+        matrix_row_t* c1   = &release_cnt[1][row];
+        matrix_row_t* c2   = &release_cnt[2][row];
+
+        // report presses at once, and cancel pending releases of them.
+        s |= r;
+        *c0 &= ~r;
+        *c1 &= ~r;
+        *c2 &= ~r;
+
+        // start pending releases.
+        matrix_row_t start = s & ~r & ~(*c0 | *c1 | *c2);
+        *c0 |= (DEBOUNCE & 1) ? start : 0;
+        *c1 |= (DEBOUNCE & 2) ? start : 0;
+        *c2 |= (DEBOUNCE & 4) ? start : 0;
+
+        // count down pending releases, and report them at zero.
+        for (uint16_t t = 0; t < elapsed; t++) {
+            matrix_row_t busy = *c0 | *c1 | *c2;
+            matrix_row_t b1   = busy & ~*c0;
+            matrix_row_t b2   = b1 & ~*c1;
+            *c0 ^= busy;
+            *c1 ^= b1;
+            *c2 ^= b2;
+            s &= ~(busy & ~(*c0 | *c1 | *c2));
+        }
+
+        // leave skipped bits as they are.
+        s |= cooked[row] & skip;
+        if (s != cooked[row]) {
+            cooked[row] = s;
+            changed     = true;
+        }
+    }
+    return changed;
+}
+
+#endif
 
-    debounce(raw_matrix, matrix + thisHand, ROWS_PER_HAND, changed);
+// merge_rows copies only changed rows, and tells whether any row is changed.
+static bool merge_rows(matrix_row_t* dst, const matrix_row_t* src) {
+    bool changed = false;
+    for (uint8_t row = 0; row < ROWS_PER_HAND; row++) {
+        if (dst[row] != src[row]) {
+            dst[row] = src[row];
+            changed  = true;
+        }
+    }
+    return changed;
+}
+
+// matrix_scan tells whether the debounced matrix is changed, not the raw one.
+uint8_t matrix_scan(void) {
+    KEYBALL_PROFILE_BEGIN(scan_since);
+    bool raw_changed = duplex_scan(raw_matrix);
+    KEYBALL_PROFILE_END(KEYBALL_PHASE_SCAN, scan_since);
+
+    KEYBALL_PROFILE_BEGIN(debounce_since);
+#ifdef DUPLEX_MATRIX_EAGER_DEBOUNCE
+    // it runs even if raw is unchanged, to count down releases.
+    (void)raw_changed;
+    bool changed = eager_debounce(raw_matrix, matrix + thisHand);
+#else
+    // debounce() doesn't tell whether cooked is changed, compare with a copy.
+    static matrix_row_t last_cooked[ROWS_PER_HAND] = {0};
+    debounce(raw_matrix, matrix + thisHand, ROWS_PER_HAND, raw_changed);
+    bool changed = merge_rows(last_cooked, matrix + thisHand);
+#endif
+    KEYBALL_PROFILE_END(KEYBALL_PHASE_DEBOUNCE, debounce_since);
 
 #ifdef SPLIT_KEYBOARD
     if (!is_keyboard_master()) {
-        // send to primary.
-        transport_slave(matrix + thatHand, matrix + thisHand);
+        // send to primary a copy, which may carry out-of-band bits.
+        matrix_row_t send[ROWS_PER_HAND];
+        memcpy(send, matrix + thisHand, sizeof(send));
+        duplex_slave_send_kb(send);
+        transport_slave(matrix + thatHand, send);
         matrix_slave_scan_kb();
         return changed;
     }
 
-    // receive from secondary.
+    // receive from secondary.  QMK's transport fetches the matrix only when
+    // its checksum is changed, so an unchanged matrix costs one byte.  The
+    // buffer is used only when it is received, then it needs no clearing.
     static bool   last_connected = false;
     matrix_row_t* that_raw       = raw_matrix + ROWS_PER_HAND;
-    memset(that_raw, 0, MATRIXSIZE_PER_HAND);
-    if (transport_master_if_connected(matrix + thisHand, that_raw)) {
+    KEYBALL_PROFILE_BEGIN(transport_since);
+    bool received = transport_master_if_connected(matrix + thisHand, that_raw);
+    KEYBALL_PROFILE_END(KEYBALL_PHASE_TRANSPORT, transport_since);
+    if (received) {
         last_connected = true;
-        if (memcmp(matrix + thatHand, that_raw, MATRIXSIZE_PER_HAND) != 0) {
-            memcpy(matrix + thatHand, that_raw, MATRIXSIZE_PER_HAND);
+        // take out-of-band bits before they are seen as changes.
+        duplex_master_recv_kb(that_raw);
+        if (merge_rows(matrix + thatHand, that_raw)) {
             changed = true;
         }
     } else if (last_connected) {
+        // release all keys of the secondary, and out-of-band bits.
         last_connected = false;
-        memset(matrix + thatHand, 0, MATRIXSIZE_PER_HAND);
-        changed = true;
+        memset(that_raw, 0, sizeof(matrix_row_t) * ROWS_PER_HAND);
+        duplex_master_recv_kb(that_raw);
+        if (merge_rows(matrix + thatHand, that_raw)) {
+            changed = true;
+        }
     }
 #endif
 
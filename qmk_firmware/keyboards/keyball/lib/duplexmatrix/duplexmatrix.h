@@ -17,4 +17,64 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+//////////////////////////////////////////////////////////////////////////////
+// Configurations
+
+/// DUPLEX_MATRIX_EAGER_DEBOUNCE replaces QMK's debounce() with a per-key
+/// eager press and deferred release debounce.  A press is reported at the
+/// first sample, and a release is reported after the key is released for
+/// DEBOUNCE milliseconds continuously, so chatter on both edges is filtered
+/// by the deferred release.  DEBOUNCE must be 1 to 7.
+//#define DUPLEX_MATRIX_EAGER_DEBOUNCE
+
+//////////////////////////////////////////////////////////////////////////////
+// API
+
 void duplex_scan_raw_post_kb(matrix_row_t out_matrix[]);
+
+/// duplex_slave_send_kb is called on the secondary with a copy of its
+/// debounced rows, just before they are sent to the primary.  Bits which it
+/// adds to unused positions are carried by the matrix sync out of band: they
+/// never pass debounce, and they aren't changes of the matrix.
+void duplex_slave_send_kb(matrix_row_t rows[]);
+
+/// duplex_master_recv_kb is called on the primary with rows which are
+/// received from the secondary, before they are merged to the matrix.  It
+/// must take and clear bits which duplex_slave_send_kb() added.  Rows are all
+/// zero when the secondary is disconnected.
+void duplex_master_recv_kb(matrix_row_t rows[]);
+
+//////////////////////////////////////////////////////////////////////////////
+// Key permutation
+
+/// duplex_perm_t is a bit permutation of a matrix row, which is applied by a
+/// lookup table for each nibble of the row.  Declare it in PROGMEM with
+/// DUPLEX_PERM_NIBBLE() for each nibble from the lowest, for example a
+/// mirror of 12 columns:
+///
+///     static const duplex_perm_t mirror PROGMEM = {
+///         DUPLEX_PERM_NIBBLE(11, 10, 9, 8),
+///         DUPLEX_PERM_NIBBLE(7, 6, 5, 4),
+///         DUPLEX_PERM_NIBBLE(3, 2, 1, 0),
+///     };
+typedef matrix_row_t duplex_perm_t[(MATRIX_COLS + 3) / 4][16];
+
+/// DUPLEX_PERM_NONE drops a bit by DUPLEX_PERM_NIBBLE().
+#define DUPLEX_PERM_NONE (-1)
+
+#define DUPLEX_PERM_BIT(v, b, d) ((((v) >> (b)) & 1) && (d) >= 0 ? (matrix_row_t)1 << ((d) < 0 ? 0 : (d)) : 0)
+#define DUPLEX_PERM_ENTRY(v, d0, d1, d2, d3) (DUPLEX_PERM_BIT(v, 0, d0) | DUPLEX_PERM_BIT(v, 1, d1) | DUPLEX_PERM_BIT(v, 2, d2) | DUPLEX_PERM_BIT(v, 3, d3))
+
+/// DUPLEX_PERM_NIBBLE declares a table of a nibble, which moves 4 bits of
+/// the nibble to bits d0 to d3 of a row respectively.
+#define DUPLEX_PERM_NIBBLE(d0, d1, d2, d3) \
+    { \
+        DUPLEX_PERM_ENTRY(0, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(1, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(2, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(3, d0, d1, d2, d3), \
+        DUPLEX_PERM_ENTRY(4, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(5, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(6, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(7, d0, d1, d2, d3), \
+        DUPLEX_PERM_ENTRY(8, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(9, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(10, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(11, d0, d1, d2, d3), \
+        DUPLEX_PERM_ENTRY(12, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(13, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(14, d0, d1, d2, d3), DUPLEX_PERM_ENTRY(15, d0, d1, d2, d3), \
+    }
+
+/// duplex_permute applies a permutation in PROGMEM to a row, by a table
+/// read for each nibble.
+matrix_row_t duplex_permute(const duplex_perm_t *perm, matrix_row_t bits);
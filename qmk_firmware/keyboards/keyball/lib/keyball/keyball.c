@@ -23,6 +23,23 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "keyball.h"
 #include "drivers/pmw3360/pmw3360.h"
 
+#if defined(KEYBALL_REPORTMOUSE_ADAPTIVE) && defined(PROTOCOL_LUFA)
+#    include <LUFA/Drivers/USB/USB.h>
+#    include "usb_descriptor.h"
+#endif
+#if (defined(DEBUG_KEYBALL_REPORT_LATENCY) || defined(KEYBALL_LINK_STATS_ENABLE) || defined(KEYBALL_PROFILE_ENABLE)) && defined(__AVR__)
+#    include "timer_avr.h"
+#endif
+#if (defined(KEYBALL_LINK_STATS_ENABLE) || defined(KEYBALL_PROFILE_ENABLE)) && defined(RAW_ENABLE)
+#    include "raw_hid.h"
+#endif
+#if defined(KEYBALL_IDLE_SLEEP) && defined(__AVR__)
+#    include <avr/sleep.h>
+#endif
+#if defined(SPLIT_KEYBOARD) && defined(KEYBALL_MOTION_FLAG_COL)
+#    include "lib/duplexmatrix/duplexmatrix.h"
+#endif
+
 #include <string.h>
 
 const uint8_t CPI_DEFAULT    = KEYBALL_CPI_DEFAULT / 100;
@@ -59,6 +76,26 @@ keyball_t keyball = {
 
 __attribute__((weak)) void keyball_on_adjust_layout(keyball_adjust_t v) {}
 
+// layout_adjusted is the last adjustment, which is done again when balls of
+// this side get ready, because the layout depends on this_have_ball.
+static keyball_adjust_t layout_adjusted = KEYBALL_ADJUST_PENDING;
+
+static void adjust_layout(keyball_adjust_t v) {
+    layout_adjusted = v;
+#if defined(SPLIT_KEYBOARD) && defined(VIA_ENABLE)
+    if (v == KEYBALL_ADJUST_PRIMARY) {
+        // adjust VIA layout options according to current combination.
+        uint8_t  layouts = (keyball.this_have_ball ? (is_keyboard_left() ? 0x02 : 0x01) : 0x00) | (keyball.that_have_ball ? (is_keyboard_left() ? 0x01 : 0x02) : 0x00);
+        uint32_t curr    = via_get_layout_options();
+        uint32_t next    = (curr & ~0x3) | layouts;
+        if (next != curr) {
+            via_set_layout_options(next);
+        }
+    }
+#endif
+    keyball_on_adjust_layout(v);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Static utilities
 
@@ -86,6 +123,47 @@ static inline int8_t clip2int8(int16_t v) {
     return (v) < -127 ? -127 : (v) > 127 ? 127 : (int8_t)v;
 }
 
+// clip2xy clips an integer fit into x or y of mouse report.  It is symmetric
+// around 0, so the result can be negated safely.
+static inline mouse_xy_report_t clip2xy(int16_t v) {
+#ifdef MOUSE_EXTENDED_REPORT
+    return v < -32767 ? -32767 : v;
+#else
+    return clip2int8(v);
+#endif
+}
+
+// clip2hv clips an integer fit into h or v of mouse report.
+static inline int16_t clip2hv(int16_t v) {
+#ifdef MOUSE_SCROLL_EXTENDED_REPORT
+    return v < -32767 ? -32767 : v;
+#else
+    return clip2int8(v);
+#endif
+}
+
+#if defined(DEBUG_KEYBALL_REPORT_LATENCY) || defined(KEYBALL_LINK_STATS_ENABLE) || defined(KEYBALL_PROFILE_ENABLE)
+// timer_read_us returns a time in microseconds, which wraps around.
+static uint32_t timer_read_us(void) {
+#    ifdef __AVR__
+    uint32_t ms;
+    uint8_t  raw;
+    ATOMIC_BLOCK_FORCEON {
+        ms  = timer_read32();
+        raw = TIMER_RAW;
+        // count a millisecond which is not handled by the interrupt yet.
+        if ((TIFR0 & _BV(OCF0A)) != 0) {
+            ms++;
+            raw = TIMER_RAW;
+        }
+    }
+    return ms * 1000 + raw * (1000000 / TIMER_RAW_FREQ);
+#    else
+    return timer_read32() * 1000;
+#    endif
+}
+#endif
+
 #ifdef OLED_ENABLE
 static const char *format_4d(int8_t d) {
     static char buf[5] = {0}; // max width (4) + NUL (1)
@@ -114,6 +192,17 @@ static const char *format_4d(int8_t d) {
     return buf;
 }
 
+#    if defined(KEYBALL_LINK_STATS_ENABLE) || defined(KEYBALL_PROFILE_ENABLE)
+static const char *format_5u(uint16_t d) {
+    static char buf[6] = {0}; // max width (5) + NUL (1)
+    for (int8_t i = 4; i >= 0; i--) {
+        buf[i] = (i == 4 || d != 0) ? (d % 10) + '0' : ' ';
+        d /= 10;
+    }
+    return buf;
+}
+#    endif
+
 static char to_1x(uint8_t x) {
     x &= 0x0f;
     return x < 10 ? x + '0' : x + 'a' - 10;
@@ -131,31 +220,280 @@ static void add_scroll_div(int8_t delta) {
 }
 
 //////////////////////////////////////////////////////////////////////////////
-// Pointing device driver
+// Ball configuration
 
-#if KEYBALL_MODEL == 46
-void keyboard_pre_init_kb(void) {
-    keyball.this_have_ball = pmw3360_init();
-    keyboard_pre_init_user();
+static inline keyball_ball_config_t ball_config(bool is_left) {
+#ifdef KEYBALL_BALL_CONFIG_ENABLE
+    return keyball.balls[is_left ? KEYBALL_BALL_LEFT : KEYBALL_BALL_RIGHT];
+#else
+    return (keyball_ball_config_t){0};
+#endif
+}
+
+static uint8_t ball_cpi(bool is_left) {
+    uint8_t cpi = ball_config(is_left).cpi;
+    return cpi != 0 ? cpi : keyball_get_cpi();
+}
+
+static uint8_t ball_scroll_div(bool is_left) {
+    uint8_t div = ball_config(is_left).sdiv;
+    return div != 0 ? div : keyball_get_scroll_div();
+}
+
+// ball_role resolves KEYBALL_ROLE_AUTO, which scrolls when scroll_by_default.
+static keyball_role_t ball_role(bool is_left, bool scroll_by_default) {
+    keyball_role_t role = ball_config(is_left).role;
+    if (role == KEYBALL_ROLE_AUTO) {
+        return scroll_by_default ? KEYBALL_ROLE_SCROLL : KEYBALL_ROLE_MOVE;
+    }
+    return role;
+}
+
+// ball_transform applies axis transform to counts of the sensor.
+static void ball_transform(bool is_left, int16_t *x, int16_t *y) {
+    uint8_t axis = ball_config(is_left).axis;
+    if (axis & KEYBALL_AXIS_SWAP) {
+        int16_t t = *x;
+        *x        = *y;
+        *y        = t;
+    }
+    if (axis & KEYBALL_AXIS_INVERT_X) {
+        *x = -*x;
+    }
+    if (axis & KEYBALL_AXIS_INVERT_Y) {
+        *y = -*y;
+    }
+}
+
+// ball_ready has bits of sensors which are ready, indexed by device of
+// PMW3360_NCS_PINS.
+static uint8_t ball_ready = 0;
+
+// apply_cpi applies CPI of this side's ball to the sensors.  It keeps the
+// selected sensor, which the main loop may be reading.
+static void apply_cpi(void) {
+    if (ball_ready == 0 || keyball.this_booting) {
+        return;
+    }
+    uint8_t cpi      = ball_cpi(is_keyboard_left()) - 1;
+    uint8_t selected = pmw3360_selected();
+    for (uint8_t dev = 0; dev < PMW3360_COUNT; dev++) {
+        if (ball_ready & (1 << dev)) {
+            pmw3360_select(dev);
+            pmw3360_cpi_set(cpi);
+        }
+    }
+    pmw3360_select(selected);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Profiler
+
+#ifdef KEYBALL_PROFILE_ENABLE
+typedef struct {
+    uint16_t count;
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+} phase_stats_t;
+
+static phase_stats_t phase_stats[KEYBALL_PHASE_COUNT] = {0};
+
+// Time and bits of phases which are measured in the current pass.
+static uint32_t phase_acc[KEYBALL_PHASE_COUNT] = {0};
+static uint8_t  phase_hit                      = 0;
+
+_Static_assert(KEYBALL_PHASE_COUNT <= 8, "phase_hit has 8 bits");
+
+uint32_t keyball_profile_begin(void) {
+    return timer_read_us();
+}
+
+void keyball_profile_end(keyball_phase_t phase, uint32_t since) {
+    phase_acc[phase] += timer_read_us() - since;
+    phase_hit |= 1 << phase;
+}
+
+static void phase_record(phase_stats_t *s, uint32_t us) {
+    if (s->count == UINT16_MAX) {
+        // halve counters to keep average.
+        s->count /= 2;
+        s->sum /= 2;
+    }
+    if (us > UINT16_MAX) {
+        us = UINT16_MAX;
+    }
+    if (s->count == 0) {
+        s->min = s->max = us;
+    } else if (us < s->min) {
+        s->min = us;
+    } else if (us > s->max) {
+        s->max = us;
+    }
+    s->count++;
+    s->sum += us;
+}
+
+// profile_pass closes a pass of the main loop.  A phase which runs some
+// times in a pass is recorded as a sum of them.
+static void profile_pass(void) {
+    static uint32_t last = 0;
+    static bool     once = false;
+    uint32_t        now  = timer_read_us();
+    if (once) {
+        phase_acc[KEYBALL_PHASE_LOOP] = now - last;
+        phase_hit |= 1 << KEYBALL_PHASE_LOOP;
+    }
+    last = now;
+    once = true;
+    for (uint8_t i = 0; i < KEYBALL_PHASE_COUNT; i++) {
+        if (phase_hit & (1 << i)) {
+            phase_record(&phase_stats[i], phase_acc[i]);
+            phase_acc[i] = 0;
+        }
+    }
+    phase_hit = 0;
+}
+
+report_mouse_t pointing_device_task_kb(report_mouse_t mouse_report) {
+    KEYBALL_PROFILE_BEGIN(since);
+    mouse_report = pointing_device_task_user(mouse_report);
+    KEYBALL_PROFILE_END(KEYBALL_PHASE_POINTING_USER, since);
+    return mouse_report;
 }
+
+#    ifdef OLED_ENABLE
+// oled_since is start of OLED rendering.  QMK transfers the buffer by I2C
+// after oled_task_kb(), so the phase ends at housekeeping_task_kb().
+static uint32_t oled_since = 0;
+static bool     oled_run   = false;
+
+bool oled_task_kb(void) {
+    oled_since = keyball_profile_begin();
+    oled_run   = true;
+    return oled_task_user();
+}
+#    endif
 #endif
 
-void pointing_device_driver_init(void) {
-#if KEYBALL_MODEL != 46
-    keyball.this_have_ball = pmw3360_init();
+//////////////////////////////////////////////////////////////////////////////
+// Idle sleep
+
+#if defined(KEYBALL_IDLE_SLEEP) && defined(__AVR__)
+// idle_since is time of the last activity: a held key, motion of this side
+// or a mouse report.
+static uint32_t idle_since = 0;
+
+static inline void idle_touch(void) {
+    idle_since = timer_read32();
+}
+
+// idle_task sleeps the CPU until a next interrupt, when no activity exists
+// for KEYBALL_IDLE_SLEEP.  Motion of the secondary is seen by the primary
+// as mouse reports, and the primary polls it at each wake up.
+static void idle_task(void) {
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        if (matrix_get_row(row) != 0) {
+            idle_touch();
+            return;
+        }
+    }
+    if (keyball.this_booting || TIMER_DIFF_32(timer_read32(), idle_since) < KEYBALL_IDLE_SLEEP) {
+        return;
+    }
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    sleep_cpu();
+    sleep_disable();
+}
+#else
+static inline void idle_touch(void) {}
 #endif
-    if (keyball.this_have_ball) {
+
+//////////////////////////////////////////////////////////////////////////////
+// Pointing device driver
+
 #if defined(KEYBALL_PMW3360_UPLOAD_SROM_ID)
 #    if KEYBALL_PMW3360_UPLOAD_SROM_ID == 0x04
-        pmw3360_srom_upload(pmw3360_srom_0x04);
+#        define KEYBALL_SROM (&pmw3360_srom_0x04)
 #    elif KEYBALL_PMW3360_UPLOAD_SROM_ID == 0x81
-        pmw3360_srom_upload(pmw3360_srom_0x81);
+#        define KEYBALL_SROM (&pmw3360_srom_0x81)
 #    else
 #        error Invalid value for KEYBALL_PMW3360_UPLOAD_SROM_ID. Please choose 0x04 or 0x81 or disable it.
 #    endif
+#else
+#    define KEYBALL_SROM NULL
+#endif
+
+#if KEYBALL_MODEL == 46
+void keyboard_pre_init_kb(void) {
+    // Keyball46 requires to detect the ball before matrix initialization,
+    // because is_keyboard_left() depends on it.  SROM is uploaded later.
+    keyball.this_have_ball = pmw3360_init();
+    keyboard_pre_init_user();
+}
 #endif
-        pmw3360_cpi_set(CPI_DEFAULT - 1);
+
+// boot_ball starts initialization of a sensor.
+static void boot_ball(uint8_t dev) {
+    pmw3360_select(dev);
+#if KEYBALL_MODEL == 46
+    // the sensor 0 has been reset by keyboard_pre_init_kb().
+    pmw3360_boot_start(KEYBALL_SROM, dev != 0);
+#else
+    pmw3360_boot_start(KEYBALL_SROM, true);
+#endif
+}
+
+void pointing_device_driver_init(void) {
+    // Sensors are reset and SROM is uploaded in background one by one, by
+    // boot_task() from housekeeping_task_kb().
+#if KEYBALL_MODEL == 46
+    if (!keyball.this_have_ball) {
+        return;
     }
+#endif
+    boot_ball(0);
+    keyball.this_booting = true;
+}
+
+static uint16_t boot_time(void) {
+    uint16_t t = timer_read();
+    return t == 0 ? 1 : t;
+}
+
+static void boot_task(void) {
+    if (!keyball.this_booting) {
+        return;
+    }
+    pmw3360_boot_status_t st = pmw3360_boot_task();
+    if (st == PMW3360_BOOT_PENDING) {
+        return;
+    }
+    // nothing else selects a sensor while booting.
+    uint8_t dev = pmw3360_selected();
+    if (st == PMW3360_BOOT_READY) {
+        ball_ready |= 1 << dev;
+        keyball.this_ballcnt++;
+    }
+    dprintf("keyball:boot_task: ball#%d=%d srom_id=%02X crc=%04X\n", dev, st == PMW3360_BOOT_READY, pmw3360_srom_id, pmw3360_srom_crc);
+    if (dev + 1 < PMW3360_COUNT) {
+        boot_ball(dev + 1);
+        return;
+    }
+    keyball.this_booting    = false;
+    keyball.boot_ball_ready = boot_time();
+#if KEYBALL_MODEL != 46
+    keyball.this_have_ball = (ball_ready & 1) != 0;
+#endif
+    dprintf("keyball:boot_task: %d balls at %u\n", keyball.this_ballcnt, keyball.boot_ball_ready);
+    // apply CPI which was set while booting.
+    apply_cpi();
+    // the secondary's scroll depends on whether the primary has a ball.
+    keyball.sync_dirty |= KEYBALL_SYNC_SCROLL;
+    // this_have_ball is settled now.  The primary doesn't negotiate until
+    // then, but the secondary may have been asked already.
+    adjust_layout(layout_adjusted);
 }
 
 uint16_t pointing_device_driver_get_cpi(void) {
@@ -166,42 +504,111 @@ void pointing_device_driver_set_cpi(uint16_t cpi) {
     keyball_set_cpi(cpi);
 }
 
+__attribute__((weak)) void keyball_on_apply_motion_to_gesture(keyball_motion_t *m, bool is_left) {
+    m->x = 0;
+    m->y = 0;
+}
+
 __attribute__((weak)) void keyball_on_apply_motion_to_mouse_move(keyball_motion_t *m, report_mouse_t *r, bool is_left) {
+    mouse_xy_report_t x = clip2xy(m->x);
+    mouse_xy_report_t y = clip2xy(m->y);
+#ifdef KEYBALL_MOTION_CARRYOVER
+    // keep the excess for next reports.
+    m->x -= x;
+    m->y -= y;
+#else
+    // clear motion
+    m->x = 0;
+    m->y = 0;
+#endif
 #if KEYBALL_MODEL == 61 || KEYBALL_MODEL == 39 || KEYBALL_MODEL == 147 || KEYBALL_MODEL == 44
-    r->x = clip2int8(m->y);
-    r->y = clip2int8(m->x);
+    r->x = y;
+    r->y = x;
     if (is_left) {
         r->x = -r->x;
         r->y = -r->y;
     }
 #elif KEYBALL_MODEL == 46
-    r->x = clip2int8(m->x);
-    r->y = -clip2int8(m->y);
+    r->x = x;
+    r->y = -y;
 #else
 #    error("unknown Keyball model")
 #endif
-    // clear motion
-    m->x = 0;
-    m->y = 0;
 }
 
+#ifdef POINTING_DEVICE_HIRES_SCROLL_ENABLE
+// hires_scroll converts motion *v to high resolution wheel units, which are
+// KEYBALL_SCROLL_HIRES_RESOLUTION per a notch, and divides it by 2^shift.
+// The fraction of a unit is kept in *frac for next reports.
+static int16_t hires_scroll(int16_t *v, int32_t *frac, uint8_t shift) {
+    int32_t a = (int32_t)*v * KEYBALL_SCROLL_HIRES_RESOLUTION + *frac;
+    int32_t u = a >> shift;
+    int16_t c = clip2hv(u < -32767 ? -32767 : u > 32767 ? 32767 : u);
+#    ifdef KEYBALL_MOTION_CARRYOVER
+    *frac = a - ((int32_t)c << shift);
+#    else
+    *frac = a - (u << shift);
+#    endif
+    *v = 0;
+    return c;
+}
+
+// hires_frac holds fractions of x and y for each source of motion: this
+// ball, that ball, scroll of the secondary and sub balls.
+static int32_t hires_frac[PMW3360_COUNT + 2][2] = {0};
+
+// hires_frac_of returns fractions for motion m.  Other motion, which a
+// user function may pass, shares ones of this ball.
+static int32_t *hires_frac_of(const keyball_motion_t *m) {
+    if (m == &keyball.that_motion) {
+        return hires_frac[1];
+    }
+#    ifdef KEYBALL_MOTION_SCROLL
+    if (m == &keyball.that_scroll) {
+        return hires_frac[2];
+    }
+#    endif
+#    if PMW3360_COUNT > 1
+    if (m >= keyball.this_sub_motion && m < keyball.this_sub_motion + PMW3360_COUNT - 1) {
+        return hires_frac[3 + (m - keyball.this_sub_motion)];
+    }
+#    endif
+    return hires_frac[0];
+}
+#endif
+
 __attribute__((weak)) void keyball_on_apply_motion_to_mouse_scroll(keyball_motion_t *m, report_mouse_t *r, bool is_left) {
+#ifdef POINTING_DEVICE_HIRES_SCROLL_ENABLE
+    // consume motion of trackball, keeping fractions for each source.
+    int32_t *f     = hires_frac_of(m);
+    uint8_t  shift = ball_scroll_div(is_left) - 1;
+    int16_t  x     = hires_scroll(&m->x, &f[0], shift);
+    int16_t  y     = hires_scroll(&m->y, &f[1], shift);
+#else
     // consume motion of trackball.
-    int16_t div = 1 << (keyball_get_scroll_div() - 1);
+    int16_t div = 1 << (ball_scroll_div(is_left) - 1);
     int16_t x = divmod16(&m->x, div);
     int16_t y = divmod16(&m->y, div);
+#    ifdef KEYBALL_MOTION_CARRYOVER
+    // keep the excess for next reports.
+    m->x += (x - clip2hv(x)) * div;
+    m->y += (y - clip2hv(y)) * div;
+    x = clip2hv(x);
+    y = clip2hv(y);
+#    endif
+#endif
 
     // apply to mouse report.
 #if KEYBALL_MODEL == 61 || KEYBALL_MODEL == 39 || KEYBALL_MODEL == 147 || KEYBALL_MODEL == 44
-    r->h = clip2int8(y);
-    r->v = -clip2int8(x);
+    r->h = clip2hv(y);
+    r->v = -clip2hv(x);
     if (is_left) {
         r->h = -r->h;
         r->v = -r->v;
     }
 #elif KEYBALL_MODEL == 46
-    r->h = clip2int8(x);
-    r->v = clip2int8(y);
+    r->h = clip2hv(x);
+    r->v = clip2hv(y);
 #else
 #    error("unknown Keyball model")
 #endif
@@ -215,73 +622,735 @@ __attribute__((weak)) void keyball_on_apply_motion_to_mouse_scroll(keyball_motio
     } else if (TIMER_DIFF_32(now, keyball.scroll_snap_last) >= KEYBALL_SCROLLSNAP_RESET_TIMER) {
         keyball.scroll_snap_tension_h = 0;
     }
-    if (abs(keyball.scroll_snap_tension_h) < KEYBALL_SCROLLSNAP_TENSION_THRESHOLD) {
-        keyball.scroll_snap_tension_h += y;
-        r->h = 0;
+    if (abs(keyball.scroll_snap_tension_h) < KEYBALL_SCROLLSNAP_TENSION_THRESHOLD) {
+        keyball.scroll_snap_tension_h += y;
+        r->h = 0;
+    }
+#elif KEYBALL_SCROLLSNAP_ENABLE == 2
+    // New behavior
+    switch (keyball_get_scrollsnap_mode()) {
+        case KEYBALL_SCROLLSNAP_MODE_VERTICAL:
+            r->h = 0;
+            break;
+        case KEYBALL_SCROLLSNAP_MODE_HORIZONTAL:
+            r->v = 0;
+            break;
+        default:
+            // pass by without doing anything
+            break;
+    }
+#endif
+}
+
+// motion_arrived tells whether new motion has arrived since the last report.
+static bool motion_arrived = false;
+
+// report_elapsed is time in milliseconds since the last report, which
+// velocities of the ball are normalized by.
+static uint8_t report_elapsed = KEYBALL_VELOCITY_PERIOD;
+
+// report_tick measures report_elapsed, and is called for each report.
+static void report_tick(void) {
+    static uint16_t last = 0;
+    uint16_t        now  = timer_read();
+    uint16_t        d    = TIMER_DIFF_16(now, last);
+    last                 = now;
+    report_elapsed       = d == 0 ? 1 : d > UINT8_MAX ? UINT8_MAX : d;
+    motion_arrived       = false;
+}
+
+#ifdef KEYBALL_POINTER_ACCEL_ENABLE
+
+// ACCEL_GAIN calculates a gain in Q8.8 for velocity index i.
+#    define ACCEL_GAIN(i, offset, slope, limit) ((i) <= (offset) ? 256 : 256 + ((i) - (offset)) * (slope) > (limit) ? (limit) : 256 + ((i) - (offset)) * (slope))
+#    define ACCEL_GAIN8(i, o, s, l) ACCEL_GAIN(i, o, s, l), ACCEL_GAIN(i + 1, o, s, l), ACCEL_GAIN(i + 2, o, s, l), ACCEL_GAIN(i + 3, o, s, l), ACCEL_GAIN(i + 4, o, s, l), ACCEL_GAIN(i + 5, o, s, l), ACCEL_GAIN(i + 6, o, s, l), ACCEL_GAIN(i + 7, o, s, l)
+#    define ACCEL_CURVE_(o, s, l) \
+        { ACCEL_GAIN8(0, o, s, l), ACCEL_GAIN8(8, o, s, l), ACCEL_GAIN8(16, o, s, l), ACCEL_GAIN8(24, o, s, l) }
+#    define ACCEL_CURVE(p) ACCEL_CURVE_(p)
+
+#    define ACCEL_INDEX_MAX 31
+
+// ACCEL_RECIP calculates KEYBALL_VELOCITY_PERIOD / e in Q8.8, which scales
+// counts in e milliseconds to velocity without a division at runtime.
+#    define ACCEL_RECIP(e) ((KEYBALL_VELOCITY_PERIOD * 256 + (e) / 2) / (e))
+#    define ACCEL_RECIP8(e) ACCEL_RECIP(e), ACCEL_RECIP(e + 1), ACCEL_RECIP(e + 2), ACCEL_RECIP(e + 3), ACCEL_RECIP(e + 4), ACCEL_RECIP(e + 5), ACCEL_RECIP(e + 6), ACCEL_RECIP(e + 7)
+
+// ACCEL_ELAPSED_MAX clamps report_elapsed for the reciprocal table.  Motion
+// after a longer gap is measured as if in this time, it is slow anyway.
+#    define ACCEL_ELAPSED_MAX 32
+
+_Static_assert(KEYBALL_VELOCITY_PERIOD < 256, "accel_recip holds Q8.8 in 16 bits");
+
+static const uint16_t accel_recip[ACCEL_ELAPSED_MAX] PROGMEM = {
+    ACCEL_RECIP8(1),
+    ACCEL_RECIP8(9),
+    ACCEL_RECIP8(17),
+    ACCEL_RECIP8(25),
+};
+
+static const uint16_t accel_curves[KEYBALL_ACCEL_PROFILE_COUNT][ACCEL_INDEX_MAX + 1] PROGMEM = {
+    ACCEL_CURVE(KEYBALL_ACCEL_PROFILE_0),
+    ACCEL_CURVE(KEYBALL_ACCEL_PROFILE_1),
+    ACCEL_CURVE(KEYBALL_ACCEL_PROFILE_2),
+    ACCEL_CURVE(KEYBALL_ACCEL_PROFILE_3),
+};
+
+typedef struct {
+    keyball_motion_t out; // accelerated motion, not reported yet
+    uint8_t          rx;  // sub-count remainder of x in 1/256
+    uint8_t          ry;  // sub-count remainder of y in 1/256
+} accel_t;
+
+static accel_t accel_this = {0};
+static accel_t accel_that = {0};
+
+// accel_axis multiplies v by gain in Q8.8, and keeps the fraction in *rem.
+static int16_t accel_axis(int16_t v, uint16_t gain, uint8_t *rem) {
+    int32_t a = (int32_t)v * gain + *rem;
+    *rem      = (uint8_t)a;
+    a >>= 8;
+    return a < -32767 ? -32767 : a > 32767 ? 32767 : (int16_t)a;
+}
+
+// accel_apply consumes motion m, accumulates accelerated one to a->out, and
+// returns it.
+static keyball_motion_t *accel_apply(keyball_motion_t *m, accel_t *a) {
+    // approximate velocity: max + min / 2, per KEYBALL_VELOCITY_PERIOD.
+    uint16_t ax = abs(m->x);
+    uint16_t ay = abs(m->y);
+    uint16_t r  = pgm_read_word(&accel_recip[MIN(report_elapsed, ACCEL_ELAPSED_MAX) - 1]);
+    uint32_t v  = ((uint32_t)(ax > ay ? ax + (ay >> 1) : ay + (ax >> 1)) * r) >> 8;
+    uint8_t  i  = MIN(v >> KEYBALL_ACCEL_VELOCITY_SHIFT, ACCEL_INDEX_MAX);
+    uint16_t g  = pgm_read_word(&accel_curves[keyball.accel_profile][i]);
+    a->out.x    = add16(a->out.x, accel_axis(m->x, g, &a->rx));
+    a->out.y    = add16(a->out.y, accel_axis(m->y, g, &a->ry));
+    m->x        = 0;
+    m->y        = 0;
+    return &a->out;
+}
+
+#endif
+
+#ifdef KEYBALL_KINETIC_SCROLL_ENABLE
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+    uint8_t elapsed; // time which the motion is measured in
+} kinetic_sample_t;
+
+typedef struct {
+    kinetic_sample_t samples[KEYBALL_KINETIC_SCROLL_SAMPLES]; // recent motion for each report
+    uint8_t          index;
+    uint8_t          idle; // time without new motion
+    bool             coasting;
+    int32_t          vx; // velocity in counts per KEYBALL_VELOCITY_PERIOD, Q8.8
+    int32_t          vy;
+    uint8_t          fx; // fraction of emitted counts
+    uint8_t          fy;
+    uint16_t         tick; // time which friction is not applied for yet
+    keyball_motion_t rest; // motion which the scroll handler left, not new one
+} kinetic_t;
+
+static kinetic_t kinetic_this = {0};
+static kinetic_t kinetic_that = {0};
+
+// kinetic_reset resets kinetic scroll, except rest which belongs to motion.
+static void kinetic_reset(kinetic_t *k) {
+    keyball_motion_t rest = k->rest;
+    memset(k, 0, sizeof(*k));
+    k->rest = rest;
+}
+
+#    if defined(SPLIT_KEYBOARD) && defined(KEYBALL_OFFLOAD_TRANSFORM)
+// that_scrolled tells whether the secondary has scrolled since the last stop,
+// so it may be coasting.
+static bool that_scrolled = false;
+
+// kinetic_stop_requested is set by the split RPC handler, and the main loop
+// stops kinetic scroll of the secondary by it.
+static volatile bool kinetic_stop_requested = false;
+#    endif
+
+// kinetic_stop stops kinetic scroll of both sides.
+static void kinetic_stop(void) {
+    kinetic_reset(&kinetic_this);
+    kinetic_reset(&kinetic_that);
+#    if defined(SPLIT_KEYBOARD) && defined(KEYBALL_OFFLOAD_TRANSFORM)
+    // the secondary scrolls its ball by itself.
+    if (is_keyboard_master() && that_scrolled) {
+        that_scrolled = false;
+        keyball.sync_dirty |= KEYBALL_SYNC_KINETIC;
+    }
+#    endif
+}
+
+// kinetic_emit returns counts to be emitted by velocity v for
+// report_elapsed, and keeps the fraction in *frac.
+static int16_t kinetic_emit(int32_t v, uint8_t *frac) {
+    int32_t p = v * report_elapsed / KEYBALL_VELOCITY_PERIOD + *frac;
+    *frac     = (uint8_t)p;
+    p >>= 8;
+    return p < -32767 ? -32767 : p > 32767 ? 32767 : (int16_t)p;
+}
+
+// kinetic_clip clips velocity in Q8.8, so that the product in kinetic_emit()
+// never overflows.
+static int32_t kinetic_clip(int32_t v) {
+    return v < -(32767L << 8) ? -(32767L << 8) : v > (32767L << 8) ? (32767L << 8) : v;
+}
+
+// kinetic_apply records motion m while the ball is rotated, and emits
+// decaying motion to m after the ball is released quickly.  m may have the
+// remainder of the last scroll, which is k->rest, so new motion is the
+// difference from it.
+static void kinetic_apply(keyball_motion_t *m, kinetic_t *k) {
+    int16_t dx    = m->x - k->rest.x;
+    int16_t dy    = m->y - k->rest.y;
+    bool    moved = dx != 0 || dy != 0;
+    if (k->coasting) {
+        if (moved) {
+            // opposite motion brakes, and others take over the scroll.
+            if ((int32_t)dx * k->vx + (int32_t)dy * k->vy < 0) {
+                m->x = 0;
+                m->y = 0;
+            }
+            kinetic_reset(k);
+            return;
+        }
+        // apply friction for each KEYBALL_VELOCITY_PERIOD.
+        for (k->tick += report_elapsed; k->tick >= KEYBALL_VELOCITY_PERIOD; k->tick -= KEYBALL_VELOCITY_PERIOD) {
+            k->vx = (k->vx * (256 - KEYBALL_KINETIC_SCROLL_FRICTION)) >> 8;
+            k->vy = (k->vy * (256 - KEYBALL_KINETIC_SCROLL_FRICTION)) >> 8;
+        }
+        m->x = add16(m->x, kinetic_emit(k->vx, &k->fx));
+        m->y = add16(m->y, kinetic_emit(k->vy, &k->fy));
+        if (labs(k->vx) < (KEYBALL_KINETIC_SCROLL_CUTOFF << 8) && labs(k->vy) < (KEYBALL_KINETIC_SCROLL_CUTOFF << 8)) {
+            kinetic_reset(k);
+        }
+        return;
+    }
+    if (moved) {
+        k->samples[k->index] = (kinetic_sample_t){.x = dx, .y = dy, .elapsed = report_elapsed};
+        k->index             = (k->index + 1) % KEYBALL_KINETIC_SCROLL_SAMPLES;
+        k->idle              = 0;
+        return;
+    }
+    // a gap of motion shorter than the period isn't a release, because
+    // frequent reports may see no motion between reads of the sensor.
+    k->idle = k->idle + report_elapsed < UINT8_MAX ? k->idle + report_elapsed : UINT8_MAX;
+    if (k->idle < KEYBALL_VELOCITY_PERIOD) {
+        return;
+    }
+    // the ball is released: estimate its velocity by recent samples.
+    int32_t  sx = 0;
+    int32_t  sy = 0;
+    uint16_t st = 0;
+    for (uint8_t i = 0; i < KEYBALL_KINETIC_SCROLL_SAMPLES; i++) {
+        sx += k->samples[i].x;
+        sy += k->samples[i].y;
+        st += k->samples[i].elapsed;
+    }
+    kinetic_reset(k);
+    if (st == 0) {
+        return;
+    }
+    k->vx       = kinetic_clip(sx * 256 * KEYBALL_VELOCITY_PERIOD / st);
+    k->vy       = kinetic_clip(sy * 256 * KEYBALL_VELOCITY_PERIOD / st);
+    k->coasting = labs(k->vx) >= (KEYBALL_KINETIC_SCROLL_THRESHOLD << 8) || labs(k->vy) >= (KEYBALL_KINETIC_SCROLL_THRESHOLD << 8);
+}
+
+#endif
+
+static void motion_to_mouse(keyball_motion_t *m, report_mouse_t *r, bool is_left, keyball_role_t role) {
+#ifdef KEYBALL_KINETIC_SCROLL_ENABLE
+    kinetic_t *k = m == &keyball.this_motion ? &kinetic_this : &kinetic_that;
+#endif
+    if (role == KEYBALL_ROLE_GESTURE) {
+#ifdef KEYBALL_KINETIC_SCROLL_ENABLE
+        kinetic_reset(k);
+#endif
+        keyball_on_apply_motion_to_gesture(m, is_left);
+    } else if ((role == KEYBALL_ROLE_SCROLL) ^ keyball.scroll_mode) {
+        // scroll mode swaps move and scroll.
+#ifdef KEYBALL_KINETIC_SCROLL_ENABLE
+        kinetic_apply(m, k);
+#endif
+        keyball_on_apply_motion_to_mouse_scroll(m, r, is_left);
+    } else {
+#ifdef KEYBALL_KINETIC_SCROLL_ENABLE
+        kinetic_reset(k);
+#endif
+#ifdef KEYBALL_POINTER_ACCEL_ENABLE
+        keyball_on_apply_motion_to_mouse_move(accel_apply(m, m == &keyball.this_motion ? &accel_this : &accel_that), r, is_left);
+#else
+        keyball_on_apply_motion_to_mouse_move(m, r, is_left);
+#endif
+    }
+#ifdef KEYBALL_KINETIC_SCROLL_ENABLE
+    // keep what the handler left, to tell new motion from it.
+    k->rest = *m;
+#endif
+}
+
+#ifdef KEYBALL_MOTION_SCROLL
+// scroll_to_mouse adds motion of sub balls to a report as scroll, which is
+// clipped.  Sub balls always scroll regardless of scroll mode.
+static void scroll_to_mouse(keyball_motion_t *m, report_mouse_t *r, bool is_left) {
+    if (m->x == 0 && m->y == 0) {
+        return;
+    }
+    report_mouse_t s = {0};
+    keyball_on_apply_motion_to_mouse_scroll(m, &s, is_left);
+    r->h = clip2hv(r->h + s.h);
+    r->v = clip2hv(r->v + s.v);
+}
+#endif
+
+#ifdef DEBUG_KEYBALL_REPORT_LATENCY
+static uint16_t latency_hist[KEYBALL_LATENCY_BUCKETS] = {0};
+static bool     latency_pending                       = false;
+static uint32_t latency_since                         = 0;
+static uint32_t latency_logged                        = 0;
+
+// latency_mark marks arrival of motion, which is not reported yet.
+static void latency_mark(void) {
+    if (!latency_pending) {
+        latency_pending = true;
+        latency_since   = timer_read_us();
+    }
+}
+
+// latency_record records latency of a mouse report, from latency_mark().
+static void latency_record(void) {
+    if (latency_pending) {
+        uint32_t d      = (timer_read_us() - latency_since) / KEYBALL_LATENCY_BUCKET_US;
+        latency_pending = false;
+        latency_hist[d < KEYBALL_LATENCY_BUCKETS ? d : KEYBALL_LATENCY_BUCKETS - 1]++;
+    }
+#    if defined(CONSOLE_ENABLE)
+    uint32_t now = timer_read32();
+    if (TIMER_DIFF_32(now, latency_logged) > 1000) {
+        latency_logged = now;
+        dprintf("keyball report latency:");
+        for (uint8_t i = 0; i < KEYBALL_LATENCY_BUCKETS; i++) {
+            dprintf(" %u", latency_hist[i]);
+        }
+        dprintf("\n");
+    }
+#    endif
+}
+#endif
+
+#if defined(SPLIT_KEYBOARD) && defined(KEYBALL_MOTION_PACING)
+// pacing_t is motion of the secondary which is being distributed over
+// reports.
+typedef struct {
+    keyball_motion_t rest;   // motion which is not distributed yet
+    uint16_t         last;   // time of the last distribution
+    uint16_t         until;  // time to complete distribution
+    uint8_t          window; // estimated duration which a packet covers
+} pacing_t;
+
+static pacing_t pacing = {0};
+
+static void pacing_push(const keyball_motion_packet_t *p) {
+    uint16_t now = timer_read();
+    // a packet of N reads covers N intervals of the sensor reads.  For a
+    // single read, reuse the last estimation.
+    if (p->count > 1) {
+        uint16_t w    = (uint16_t)p->span * p->count / (p->count - 1);
+        pacing.window = w < KEYBALL_MOTION_PACING_MAX_SPAN ? w : KEYBALL_MOTION_PACING_MAX_SPAN;
+    }
+    if (pacing.rest.x == 0 && pacing.rest.y == 0) {
+        pacing.last  = now;
+        pacing.until = now;
+    }
+    // play motion back within the window after the reads, then the delay
+    // of the link is compensated by the age.
+    uint16_t until = now + (p->age < pacing.window ? pacing.window - p->age : 0);
+    if ((int16_t)(until - pacing.until) > 0) {
+        pacing.until = until;
+    }
+    pacing.rest.x = add16(pacing.rest.x, p->x);
+    pacing.rest.y = add16(pacing.rest.y, p->y);
+}
+
+static void pacing_pull(void) {
+    if (pacing.rest.x == 0 && pacing.rest.y == 0) {
+        return;
+    }
+    uint16_t now     = timer_read();
+    uint16_t elapsed = now - pacing.last;
+    int16_t  remain  = pacing.until - now;
+    int16_t  dx      = pacing.rest.x;
+    int16_t  dy      = pacing.rest.y;
+    if (remain > 0) {
+        if (elapsed == 0) {
+            return;
+        }
+        // distribute linearly, the remainder is kept for next reports.
+        dx = (int32_t)dx * elapsed / (elapsed + remain);
+        dy = (int32_t)dy * elapsed / (elapsed + remain);
+    }
+    pacing.last           = now;
+    pacing.rest.x        -= dx;
+    pacing.rest.y        -= dy;
+    motion_arrived        = motion_arrived || dx != 0 || dy != 0;
+    keyball.that_motion.x = add16(keyball.that_motion.x, dx);
+    keyball.that_motion.y = add16(keyball.that_motion.y, dy);
+}
+#endif
+
+#if defined(KEYBALL_REPORTMOUSE_ADAPTIVE)
+// mouse_endpoint_ready checks whether the host has taken the previous mouse
+// report, so the next one can be sent without waiting.
+static bool mouse_endpoint_ready(void) {
+#    ifdef PROTOCOL_LUFA
+    if (USB_DeviceState != DEVICE_STATE_Configured) {
+        // reports are discarded without waiting.
+        return true;
+    }
+    uint8_t prev = Endpoint_GetCurrentEndpoint();
+    Endpoint_SelectEndpoint(MOUSE_IN_EPNUM | ENDPOINT_DIR_IN);
+    bool ready = Endpoint_IsINReady();
+    Endpoint_SelectEndpoint(prev);
+    return ready;
+#    else
+    return true;
+#    endif
+}
+#endif
+
+static inline bool should_report(void) {
+    uint32_t now = timer_read32();
+#if defined(KEYBALL_REPORTMOUSE_ADAPTIVE)
+    // report motion as soon as possible, otherwise report in the interval.
+    // coasting of kinetic scroll is motion too.
+    static uint32_t last  = 0;
+    bool            moved = motion_arrived;
+#    ifdef KEYBALL_KINETIC_SCROLL_ENABLE
+    moved = moved || kinetic_this.coasting || kinetic_that.coasting;
+#    endif
+    if (moved ? TIMER_DIFF_32(now, last) < KEYBALL_REPORTMOUSE_MIN_INTERVAL || !mouse_endpoint_ready() : TIMER_DIFF_32(now, last) < KEYBALL_REPORTMOUSE_INTERVAL) {
+        return false;
+    }
+    last = now;
+#elif defined(KEYBALL_REPORTMOUSE_INTERVAL) && KEYBALL_REPORTMOUSE_INTERVAL > 0
+    // throttling mouse report rate.
+    static uint32_t last = 0;
+    if (TIMER_DIFF_32(now, last) < KEYBALL_REPORTMOUSE_INTERVAL) {
+        return false;
+    }
+    last = now;
+#endif
+#if defined(KEYBALL_SCROLLBALL_INHIVITOR) && KEYBALL_SCROLLBALL_INHIVITOR > 0
+    if (TIMER_DIFF_32(now, keyball.scroll_mode_changed) < KEYBALL_SCROLLBALL_INHIVITOR) {
+        keyball.this_motion.x = 0;
+        keyball.this_motion.y = 0;
+        keyball.that_motion.x = 0;
+        keyball.that_motion.y = 0;
+#    if defined(SPLIT_KEYBOARD) && defined(KEYBALL_MOTION_PACING)
+        // forget the window too, which was measured for dropped motion.
+        pacing = (pacing_t){0};
+#    endif
+    }
+#endif
+    report_tick();
+    return true;
+}
+
+#ifdef SPLIT_KEYBOARD
+// handoff passes motion of the secondary from the main loop to the split RPC
+// handler, which runs in an interrupt, without disabling interrupts.
+//
+// The main loop writes wrapping totals into the back buffer, then publishes
+// it by flipping index, which is a single byte store.  The handler can't be
+// preempted by the main loop, so it always sees a complete buffer, and it
+// takes the difference from the totals which it has taken.  Only the main
+// loop writes the totals, so no count is dropped.
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+#    ifdef KEYBALL_MOTION_SCROLL
+    uint16_t h;
+    uint16_t v;
+#    endif
+#    ifdef KEYBALL_MOTION_PACING
+    uint8_t  count; // wrapping total of sensor reads
+    uint16_t first; // time of the first read which is not taken entirely
+    uint16_t last;  // time of the last read
+#    endif
+} handoff_buf_t;
+
+static struct {
+    handoff_buf_t    buf[2];
+    volatile uint8_t index;
+    volatile uint8_t seq;   // incremented by each publish
+    volatile uint8_t acked; // seq which the handler has taken entirely
+    handoff_buf_t    taken; // owned by the handler
+} handoff = {0};
+
+// handoff_put adds motion, or a mouse report with KEYBALL_OFFLOAD_TRANSFORM.
+// h and v are motion of sub balls without KEYBALL_OFFLOAD_TRANSFORM.
+static void handoff_put(int16_t x, int16_t y, int16_t h, int16_t v) {
+    const handoff_buf_t *curr = &handoff.buf[handoff.index];
+    handoff_buf_t       *next = &handoff.buf[handoff.index ^ 1];
+    next->x                   = curr->x + (uint16_t)x;
+    next->y                   = curr->y + (uint16_t)y;
+#    ifdef KEYBALL_MOTION_SCROLL
+    next->h = curr->h + (uint16_t)h;
+    next->v = curr->v + (uint16_t)v;
+#    endif
+#    ifdef KEYBALL_MOTION_PACING
+    uint16_t now = timer_read();
+    next->count  = curr->count + 1;
+    next->first  = handoff.acked == handoff.seq ? now : curr->first;
+    next->last   = now;
+#    endif
+    // the buffer isn't volatile, so keep the compiler from moving its stores
+    // past the flip.
+    __asm__ volatile("" ::: "memory");
+    handoff.index ^= 1;
+    // publish seq after the buffer.  The other order may let the handler
+    // ack the seq with older totals, then the motion flag would be lost.
+    handoff.seq++;
+}
+
+static inline bool handoff_pending(void) {
+    return handoff.seq != handoff.acked;
+}
+
+// handoff_take takes an axis up to int8_t, and tells whether the excess is
+// left.  It is called by the handler.
+static int8_t handoff_take(uint16_t total, uint16_t *taken, bool *left) {
+    int16_t d = total - *taken;
+    int8_t  c = clip2int8(d);
+    *taken += (uint16_t)c;
+    *left |= c != d;
+    return c;
+}
+#endif
+
+#if PMW3360_COUNT > 1
+// add_sub_motion adds motion of a sub ball.  The secondary hands it off as
+// scroll, unless it transforms motion by itself.
+static void add_sub_motion(uint8_t dev, int16_t x, int16_t y) {
+#    if defined(SPLIT_KEYBOARD) && !defined(KEYBALL_OFFLOAD_TRANSFORM)
+    if (!is_keyboard_master()) {
+        if (x != 0 || y != 0) {
+            handoff_put(0, 0, x, y);
+        }
+        return;
+    }
+#    endif
+    keyball_motion_t *m = &keyball.this_sub_motion[dev - 1];
+    m->x                = add16(m->x, x);
+    m->y                = add16(m->y, y);
+}
+#endif
+
+static void add_this_motion(uint8_t dev, pmw3360_burst_t *d) {
+    // keep surface quality of the main ball as telemetry.
+    if (dev == 0) {
+        keyball.this_squal   = d->squal;
+        keyball.this_shutter = (d->shutter_upper << 8) | d->shutter_lower;
+    }
+    // drop motion while the ball is lifted or being cleaned.
+    if ((d->mot & pmw3360_Lift_Stat) != 0) {
+        return;
     }
-#elif KEYBALL_SCROLLSNAP_ENABLE == 2
-    // New behavior
-    switch (keyball_get_scrollsnap_mode()) {
-        case KEYBALL_SCROLLSNAP_MODE_VERTICAL:
-            r->h = 0;
-            break;
-        case KEYBALL_SCROLLSNAP_MODE_HORIZONTAL:
-            r->v = 0;
-            break;
-        default:
-            // pass by without doing anything
-            break;
+    int16_t x = d->x;
+    int16_t y = d->y;
+    if (x != 0 || y != 0) {
+        idle_touch();
+        motion_arrived = true;
+    }
+    ball_transform(is_keyboard_left(), &x, &y);
+#if PMW3360_COUNT > 1
+    if (dev != 0) {
+        add_sub_motion(dev, x, y);
+        return;
+    }
+#endif
+#if defined(SPLIT_KEYBOARD) && !defined(KEYBALL_OFFLOAD_TRANSFORM)
+    if (!is_keyboard_master()) {
+        if (x != 0 || y != 0) {
+            handoff_put(x, y, 0, 0);
+        }
+        return;
+    }
+#endif
+    keyball.this_motion.x = add16(keyball.this_motion.x, x);
+    keyball.this_motion.y = add16(keyball.this_motion.y, y);
+#ifdef DEBUG_KEYBALL_REPORT_LATENCY
+    if (d->x != 0 || d->y != 0) {
+        latency_mark();
     }
 #endif
 }
 
-static void motion_to_mouse(keyball_motion_t *m, report_mouse_t *r, bool is_left, bool as_scroll) {
-    if (as_scroll) {
-        keyball_on_apply_motion_to_mouse_scroll(m, r, is_left);
-    } else {
-        keyball_on_apply_motion_to_mouse_move(m, r, is_left);
-    }
+#ifdef PMW3360_ASYNC_ENABLE
+static pmw3360_burst_t burst_motion  = {0};
+static bool           burst_pending = false;
+static uint8_t        burst_dev     = 0;
+
+static void burst_done(void *arg) {
+    add_this_motion(burst_dev, &burst_motion);
+    burst_pending = false;
 }
+#endif
 
-static inline bool should_report(void) {
-    uint32_t now = timer_read32();
-#if defined(KEYBALL_REPORTMOUSE_INTERVAL) && KEYBALL_REPORTMOUSE_INTERVAL > 0
-    // throttling mouse report rate.
-    static uint32_t last = 0;
-    if (TIMER_DIFF_32(now, last) < KEYBALL_REPORTMOUSE_INTERVAL) {
-        return false;
+// next_ball picks a sensor to be read in this pass, in round robin over
+// sensors which are ready.  ball_ready must not be zero.
+static uint8_t next_ball(void) {
+#if PMW3360_COUNT > 1
+    static uint8_t dev = 0;
+    do {
+        dev = dev + 1 < PMW3360_COUNT ? dev + 1 : 0;
+    } while ((ball_ready & (1 << dev)) == 0);
+    return dev;
+#else
+    return 0;
+#endif
+}
+
+#if defined(SPLIT_KEYBOARD) && defined(KEYBALL_OFFLOAD_TRANSFORM)
+// offload_transform transforms motion on the secondary in the cadence of
+// reports, then hands it off.  Scroll mode of the secondary's ball is
+// inverted when the primary has a ball, as the primary does.
+static void offload_transform(void) {
+    static uint32_t last  = 0;
+    uint32_t        now   = timer_read32();
+    bool            moved = motion_arrived;
+#    ifdef KEYBALL_KINETIC_SCROLL_ENABLE
+    moved = moved || kinetic_this.coasting;
+#    endif
+#    ifdef KEYBALL_REPORTMOUSE_ADAPTIVE
+    uint32_t interval = moved ? KEYBALL_REPORTMOUSE_MIN_INTERVAL : KEYBALL_REPORTMOUSE_INTERVAL;
+#    else
+    uint32_t interval = KEYBALL_REPORTMOUSE_INTERVAL;
+#    endif
+    if (TIMER_DIFF_32(now, last) < interval) {
+        return;
     }
     last = now;
-#endif
-#if defined(KEYBALL_SCROLLBALL_INHIVITOR) && KEYBALL_SCROLLBALL_INHIVITOR > 0
+    report_tick();
+#    ifdef KEYBALL_KINETIC_SCROLL_ENABLE
+    if (kinetic_stop_requested) {
+        kinetic_stop_requested = false;
+        kinetic_stop();
+    }
+#    endif
+#    if defined(KEYBALL_SCROLLBALL_INHIVITOR) && KEYBALL_SCROLLBALL_INHIVITOR > 0
     if (TIMER_DIFF_32(now, keyball.scroll_mode_changed) < KEYBALL_SCROLLBALL_INHIVITOR) {
         keyball.this_motion.x = 0;
         keyball.this_motion.y = 0;
-        keyball.that_motion.x = 0;
-        keyball.that_motion.y = 0;
     }
-#endif
-    return true;
+#    endif
+    report_mouse_t r = {0};
+    motion_to_mouse(&keyball.this_motion, &r, is_keyboard_left(), ball_role(is_keyboard_left(), keyball.that_have_ball));
+#    if PMW3360_COUNT > 1
+    for (uint8_t i = 0; i < PMW3360_COUNT - 1; i++) {
+        scroll_to_mouse(&keyball.this_sub_motion[i], &r, is_keyboard_left());
+    }
+#    endif
+    if (r.x != 0 || r.y != 0 || r.h != 0 || r.v != 0) {
+        handoff_put(r.x, r.y, r.h, r.v);
+    }
+}
+
+// offload_merge adds the report which is transformed by the secondary.  The
+// excess is kept for next reports.
+static void offload_merge(report_mouse_t *r) {
+    int16_t x = add16(r->x, keyball.that_motion.x);
+    int16_t y = add16(r->y, keyball.that_motion.y);
+    int16_t h = add16(r->h, keyball.that_scroll.x);
+    int16_t v = add16(r->v, keyball.that_scroll.y);
+    r->x      = clip2xy(x);
+    r->y      = clip2xy(y);
+    r->h      = clip2hv(h);
+    r->v      = clip2hv(v);
+
+    keyball.that_motion.x = x - r->x;
+    keyball.that_motion.y = y - r->y;
+    keyball.that_scroll.x = h - r->h;
+    keyball.that_scroll.y = v - r->v;
 }
+#endif
 
 report_mouse_t pointing_device_driver_get_report(report_mouse_t rep) {
-    // fetch from optical sensor.
-    if (keyball.this_have_ball) {
-        pmw3360_motion_t d = {0};
-        if (pmw3360_motion_burst(&d)) {
-            ATOMIC_BLOCK_FORCEON {
-                keyball.this_motion.x = add16(keyball.this_motion.x, d.x);
-                keyball.this_motion.y = add16(keyball.this_motion.y, d.y);
+#ifdef SPLIT_KEYBOARD
+    // apply CPI which is requested by primary. See rpc_sync_state_handler().
+    if (!is_keyboard_master() && keyball.cpi_changed) {
+        keyball_set_cpi(keyball.cpi_value);
+        keyball.cpi_changed = false;
+    }
+#endif
+    // fetch from optical sensors, only when it has motion.
+    if (ball_ready != 0 && !keyball.this_booting) {
+        KEYBALL_PROFILE_BEGIN(since);
+#ifdef PMW3360_ASYNC_ENABLE
+        // pick up the result of motion burst which started at the last pass,
+        // then start a next one.
+        pmw3360_async_task();
+        if (!burst_pending) {
+            pmw3360_select(next_ball());
+            if (pmw3360_motion_pending()) {
+                burst_dev     = pmw3360_selected();
+                burst_pending = pmw3360_motion_burst_ex_async(&burst_motion, burst_done, NULL);
             }
         }
+#else
+        pmw3360_burst_t d = {0};
+        pmw3360_select(next_ball());
+        if (pmw3360_motion_pending() && pmw3360_motion_burst_ex(&d)) {
+            add_this_motion(pmw3360_selected(), &d);
+        }
+#endif
+        KEYBALL_PROFILE_END(KEYBALL_PHASE_SENSOR, since);
+    }
+#if defined(SPLIT_KEYBOARD) && defined(KEYBALL_MOTION_PACING)
+    if (is_keyboard_master()) {
+        pacing_pull();
+    }
+#endif
+#if defined(SPLIT_KEYBOARD) && defined(KEYBALL_OFFLOAD_TRANSFORM)
+    // transform motion of the secondary here, then hand it off as a report.
+    if (!is_keyboard_master()) {
+        offload_transform();
+        return rep;
     }
+#endif
     // report mouse event, if keyboard is primary.
     if (is_keyboard_master() && should_report()) {
         // modify mouse report by PMW3360 motion.
-        motion_to_mouse(&keyball.this_motion, &rep, is_keyboard_left(), keyball.scroll_mode);
-        motion_to_mouse(&keyball.that_motion, &rep, !is_keyboard_left(), keyball.scroll_mode ^ keyball.this_have_ball);
+        motion_to_mouse(&keyball.this_motion, &rep, is_keyboard_left(), ball_role(is_keyboard_left(), false));
+#if PMW3360_COUNT > 1
+        for (uint8_t i = 0; i < PMW3360_COUNT - 1; i++) {
+            scroll_to_mouse(&keyball.this_sub_motion[i], &rep, is_keyboard_left());
+        }
+#endif
+#if defined(SPLIT_KEYBOARD) && defined(KEYBALL_OFFLOAD_TRANSFORM)
+        offload_merge(&rep);
+#else
+        motion_to_mouse(&keyball.that_motion, &rep, !is_keyboard_left(), ball_role(!is_keyboard_left(), keyball.this_have_ball));
+#    if defined(SPLIT_KEYBOARD) && defined(KEYBALL_MOTION_SCROLL)
+        scroll_to_mouse(&keyball.that_scroll, &rep, !is_keyboard_left());
+#    endif
+#endif
         // store mouse report for OLED.
         keyball.last_mouse = rep;
+        if (rep.x != 0 || rep.y != 0 || rep.h != 0 || rep.v != 0) {
+            idle_touch();
+        }
+#ifdef DEBUG_KEYBALL_REPORT_LATENCY
+        latency_record();
+#endif
+        if (keyball.boot_first_motion == 0 && (rep.x != 0 || rep.y != 0 || rep.h != 0 || rep.v != 0)) {
+            keyball.boot_first_motion = boot_time();
+            dprintf("keyball: first motion at %u\n", keyball.boot_first_motion);
+        }
     }
     return rep;
 }
@@ -291,86 +1360,326 @@ report_mouse_t pointing_device_driver_get_report(report_mouse_t rep) {
 
 #ifdef SPLIT_KEYBOARD
 
+#    ifdef KEYBALL_LINK_STATS_ENABLE
+typedef struct {
+    uint16_t attempts;
+    uint16_t failures;
+    uint16_t retries;
+    uint16_t rtt_min;
+    uint16_t rtt_max;
+    uint32_t rtt_sum;
+    bool     again; // next attempt is a retry
+} link_stats_t;
+
+static link_stats_t link_stats[KEYBALL_LINK_COUNT] = {0};
+#    endif
+
+// link_exec executes a transaction, and records its stats.
+static bool link_exec(keyball_link_t link, int8_t id, uint8_t in_len, const void *in_data, uint8_t out_len, void *out_data) {
+#    ifdef KEYBALL_LINK_STATS_ENABLE
+    link_stats_t *s = &link_stats[link];
+    if (s->attempts == UINT16_MAX) {
+        // halve all counters to keep ratios and average.
+        s->attempts /= 2;
+        s->failures /= 2;
+        s->retries /= 2;
+        s->rtt_sum /= 2;
+    }
+    s->attempts++;
+    if (s->again) {
+        s->retries++;
+    }
+    uint32_t since = timer_read_us();
+    bool     ok    = transaction_rpc_exec(id, in_len, in_data, out_len, out_data);
+    uint32_t rtt   = timer_read_us() - since;
+    s->again       = !ok;
+    if (!ok) {
+        s->failures++;
+        return false;
+    }
+    if (rtt > UINT16_MAX) {
+        rtt = UINT16_MAX;
+    }
+    if (s->attempts - s->failures == 1) {
+        s->rtt_min = s->rtt_max = rtt;
+    } else if (rtt < s->rtt_min) {
+        s->rtt_min = rtt;
+    } else if (rtt > s->rtt_max) {
+        s->rtt_max = rtt;
+    }
+    s->rtt_sum += rtt;
+    return true;
+#    else
+    return transaction_rpc_exec(id, in_len, in_data, out_len, out_data);
+#    endif
+}
+
+// link_reject marks the last succeeded transaction as rejected by its
+// content, so next attempt is counted as a retry.
+static void link_reject(keyball_link_t link, bool failure) {
+#    ifdef KEYBALL_LINK_STATS_ENABLE
+    link_stats[link].again = true;
+    if (failure) {
+        link_stats[link].failures++;
+    }
+#    endif
+}
+
 static void rpc_get_info_handler(uint8_t in_buflen, const void *in_data, uint8_t out_buflen, void *out_data) {
     keyball_info_t info = {
-        .ballcnt = keyball.this_have_ball ? 1 : 0,
+        .ballcnt = keyball.this_ballcnt,
+        .booting = keyball.this_booting,
     };
     *(keyball_info_t *)out_data = info;
-    keyball_on_adjust_layout(KEYBALL_ADJUST_SECONDARY);
+    adjust_layout(KEYBALL_ADJUST_SECONDARY);
 }
 
 static void rpc_get_info_invoke(void) {
+    static bool     connected  = false;
     static bool     negotiated = false;
-    static uint32_t last_sync  = 0;
+    static bool     timed_out  = false;
+    static uint16_t since      = 0;
+    static uint16_t last_sync  = 0;
+    static uint16_t interval   = 0;
     static int      round      = 0;
-    uint32_t        now        = timer_read32();
-    if (negotiated || TIMER_DIFF_32(now, last_sync) < KEYBALL_TX_GETINFO_INTERVAL) {
+    uint16_t        now        = timer_read();
+    // renegotiate when the link recovers, because the secondary may have
+    // been replugged or rebooted.
+    if (is_transport_connected() != connected) {
+        connected = !connected;
+        if (!connected) {
+            dprintf("keyball:rpc_get_info_invoke: link lost\n");
+            keyball.that_enable    = false;
+            keyball.that_have_ball = false;
+            keyball.that_ballcnt   = 0;
+            adjust_layout(KEYBALL_ADJUST_PENDING);
+            return;
+        }
+        negotiated = false;
+        timed_out  = false;
+        since      = now;
+        interval   = 0;
+        round      = 0;
+    }
+    // wait for balls of this side too, the layout depends on this_have_ball.
+    if (!connected || negotiated || keyball.this_booting || TIMER_DIFF_16(now, last_sync) < interval) {
         return;
     }
     last_sync = now;
     round++;
     keyball_info_t recv = {0};
-    if (!transaction_rpc_exec(KEYBALL_GET_INFO, 0, NULL, sizeof(recv), &recv)) {
-        if (round < KEYBALL_TX_GETINFO_MAXTRY) {
-            dprintf("keyball:rpc_get_info_invoke: missed #%d\n", round);
-            return;
+    // retry with exponential backoff, while the secondary is not ready or
+    // the ball of secondary is initializing.
+    if (!link_exec(KEYBALL_LINK_GET_INFO, KEYBALL_GET_INFO, 0, NULL, sizeof(recv), &recv) || recv.booting) {
+        link_reject(KEYBALL_LINK_GET_INFO, false);
+        interval = interval == 0 ? KEYBALL_TX_GETINFO_INTERVAL_MIN : interval * 2;
+        if (interval > KEYBALL_TX_GETINFO_INTERVAL_MAX) {
+            interval = KEYBALL_TX_GETINFO_INTERVAL_MAX;
         }
+        dprintf("keyball:rpc_get_info_invoke: missed #%d, next in %u ms\n", round, interval);
+        if (!timed_out && TIMER_DIFF_16(now, since) >= KEYBALL_TX_GETINFO_TIMEOUT) {
+            // give up waiting: the secondary is absent until it answers, and
+            // the layout is settled without it.  Retries continue.
+            timed_out              = true;
+            keyball.that_enable    = false;
+            keyball.that_have_ball = false;
+            keyball.that_ballcnt   = 0;
+            adjust_layout(KEYBALL_ADJUST_PRIMARY);
+        }
+        return;
     }
     negotiated             = true;
     keyball.that_enable    = true;
     keyball.that_have_ball = recv.ballcnt > 0;
-    dprintf("keyball:rpc_get_info_invoke: negotiated #%d %d\n", round, keyball.that_have_ball);
+    keyball.that_ballcnt   = recv.ballcnt;
+    keyball.sync_dirty     = KEYBALL_SYNC_ALL;
+    keyball.negotiate_time = TIMER_DIFF_16(now, since);
+    if (keyball.negotiate_count < UINT8_MAX) {
+        keyball.negotiate_count++;
+    }
+    if (keyball.boot_negotiated == 0) {
+        keyball.boot_negotiated = boot_time();
+    }
+    dprintf("keyball:rpc_get_info_invoke: negotiated #%d %d in %u ms\n", round, keyball.that_have_ball, keyball.negotiate_time);
 
     // split keyboard negotiation completed.
+    adjust_layout(KEYBALL_ADJUST_PRIMARY);
+}
+
+#    ifdef KEYBALL_MOTION_FLAG_COL
 
-#    ifdef VIA_ENABLE
-    // adjust VIA layout options according to current combination.
-    uint8_t  layouts = (keyball.this_have_ball ? (is_keyboard_left() ? 0x02 : 0x01) : 0x00) | (keyball.that_have_ball ? (is_keyboard_left() ? 0x01 : 0x02) : 0x00);
-    uint32_t curr    = via_get_layout_options();
-    uint32_t next    = (curr & ~0x3) | layouts;
-    if (next != curr) {
-        via_set_layout_options(next);
+#        if KEYBALL_MOTION_FLAG_COL >= (MATRIX_COLS <= 8 ? 8 : MATRIX_COLS <= 16 ? 16 : 32)
+#            error KEYBALL_MOTION_FLAG_COL is out of matrix_row_t.
+#        endif
+
+#        define MOTION_FLAG_BIT ((matrix_row_t)1 << KEYBALL_MOTION_FLAG_COL)
+
+// that_motion_flag is the motion flag which the primary received last.
+static bool that_motion_flag = false;
+
+void duplex_slave_send_kb(matrix_row_t rows[]) {
+    // raise the motion flag only in rows which are sent, so it never reaches
+    // the debounced matrix.
+    if (handoff_pending()) {
+        rows[KEYBALL_MOTION_FLAG_ROW] |= MOTION_FLAG_BIT;
     }
-#    endif
+}
 
-    keyball_on_adjust_layout(KEYBALL_ADJUST_PRIMARY);
+void duplex_master_recv_kb(matrix_row_t rows[]) {
+    that_motion_flag = (rows[KEYBALL_MOTION_FLAG_ROW] & MOTION_FLAG_BIT) != 0;
+    rows[KEYBALL_MOTION_FLAG_ROW] &= ~MOTION_FLAG_BIT;
 }
 
+#    endif
+
 static void rpc_get_motion_handler(uint8_t in_buflen, const void *in_data, uint8_t out_buflen, void *out_data) {
-    *(keyball_motion_t *)out_data = keyball.this_motion;
-    // clear motion
-    keyball.this_motion.x = 0;
-    keyball.this_motion.y = 0;
+    keyball_motion_packet_t *p    = (keyball_motion_packet_t *)out_data;
+    const handoff_buf_t     *curr = &handoff.buf[handoff.index];
+    uint8_t                  seq  = handoff.seq;
+    bool                     left = false;
+    // the excess is kept, it will be sent by next packets.
+    p->x = handoff_take(curr->x, &handoff.taken.x, &left);
+    p->y = handoff_take(curr->y, &handoff.taken.y, &left);
+#    ifdef KEYBALL_MOTION_SCROLL
+    p->h = handoff_take(curr->h, &handoff.taken.h, &left);
+    p->v = handoff_take(curr->v, &handoff.taken.v, &left);
+#    endif
+#    ifdef KEYBALL_MOTION_PACING
+    uint16_t now   = timer_read();
+    uint16_t span  = curr->last - curr->first;
+    uint16_t age   = now - curr->last;
+    uint8_t  count = curr->count - handoff.taken.count;
+    p->span        = span < UINT8_MAX ? span : UINT8_MAX;
+    p->age         = age < UINT8_MAX ? age : UINT8_MAX;
+    p->count       = count;
+#    endif
+    if (!left) {
+        handoff.acked = seq;
+#    ifdef KEYBALL_MOTION_PACING
+        // restart timing for next reads.
+        handoff.taken.count = curr->count;
+#    endif
+    }
 }
 
 static void rpc_get_motion_invoke(void) {
     static uint32_t last_sync = 0;
+    static bool     more      = false;
     uint32_t        now       = timer_read32();
-    if (TIMER_DIFF_32(now, last_sync) < KEYBALL_TX_GETMOTION_INTERVAL) {
+#    ifdef KEYBALL_MOTION_FLAG_COL
+    // fetch motion only when secondary raises the flag, or the last packet
+    // was saturated.
+    if (!more && (!that_motion_flag || TIMER_DIFF_32(now, last_sync) < KEYBALL_TX_GETMOTION_INTERVAL)) {
         return;
     }
-    keyball_motion_t recv = {0};
-    if (transaction_rpc_exec(KEYBALL_GET_MOTION, 0, NULL, sizeof(recv), &recv)) {
+#    else
+    if (!more && TIMER_DIFF_32(now, last_sync) < KEYBALL_TX_GETMOTION_INTERVAL) {
+        return;
+    }
+#    endif
+    keyball_motion_packet_t recv = {0};
+    more                         = false;
+    if (link_exec(KEYBALL_LINK_GET_MOTION, KEYBALL_GET_MOTION, 0, NULL, sizeof(recv), &recv)) {
+#    ifdef KEYBALL_MOTION_PACING
+        pacing_push(&recv);
+#    else
         keyball.that_motion.x = add16(keyball.that_motion.x, recv.x);
         keyball.that_motion.y = add16(keyball.that_motion.y, recv.y);
+        motion_arrived        = motion_arrived || recv.x != 0 || recv.y != 0;
+#    endif
+        more = recv.x == 127 || recv.x == -127 || recv.y == 127 || recv.y == -127;
+#    ifdef KEYBALL_MOTION_SCROLL
+        keyball.that_scroll.x = add16(keyball.that_scroll.x, recv.h);
+        keyball.that_scroll.y = add16(keyball.that_scroll.y, recv.v);
+        motion_arrived        = motion_arrived || recv.h != 0 || recv.v != 0;
+#        if defined(KEYBALL_OFFLOAD_TRANSFORM) && defined(KEYBALL_KINETIC_SCROLL_ENABLE)
+        that_scrolled = that_scrolled || recv.h != 0 || recv.v != 0;
+#        endif
+        more |= recv.h == 127 || recv.h == -127 || recv.v == 127 || recv.v == -127;
+#    endif
+#    ifdef DEBUG_KEYBALL_REPORT_LATENCY
+        if (recv.x != 0 || recv.y != 0) {
+            latency_mark();
+        }
+#    endif
     }
     last_sync = now;
     return;
 }
 
-static void rpc_set_cpi_handler(uint8_t in_buflen, const void *in_data, uint8_t out_buflen, void *out_data) {
-    keyball_set_cpi(*(keyball_cpi_t *)in_data);
+static void rpc_sync_state_handler(uint8_t in_buflen, const void *in_data, uint8_t out_buflen, void *out_data) {
+    const keyball_sync_t *req = (const keyball_sync_t *)in_data;
+    if (req->dirty & KEYBALL_SYNC_CPI) {
+        // This is called from an interrupt, which may preempt SPI transfers
+        // of the main loop.  Defer to apply the CPI to the sensor in the main
+        // loop.
+        keyball.cpi_value   = req->cpi;
+        keyball.cpi_changed = true;
+    }
+    if (req->dirty & KEYBALL_SYNC_SCROLL) {
+        keyball_set_scroll_mode(req->scroll_mode);
+        keyball_set_scroll_div(req->scroll_div);
+        keyball.that_have_ball = req->have_ball;
+    }
+    if (req->dirty & KEYBALL_SYNC_SCROLLSNAP) {
+        keyball_set_scrollsnap_mode(req->scrollsnap_mode);
+    }
+    if (req->dirty & KEYBALL_SYNC_OLED) {
+        keyball.oled_flags = req->oled_flags;
+    }
+    if (req->dirty & KEYBALL_SYNC_USER) {
+        memcpy(keyball.sync_user, req->user, sizeof(keyball.sync_user));
+    }
+    if (req->dirty & KEYBALL_SYNC_ACCEL) {
+        keyball_set_accel_profile(req->accel_profile);
+    }
+#    if defined(KEYBALL_OFFLOAD_TRANSFORM) && defined(KEYBALL_KINETIC_SCROLL_ENABLE)
+    if (req->dirty & KEYBALL_SYNC_KINETIC) {
+        // kinetic scroll is being updated by the main loop, let it stop.
+        kinetic_stop_requested = true;
+    }
+#    endif
+#    ifdef KEYBALL_BALL_CONFIG_ENABLE
+    if (req->dirty & KEYBALL_SYNC_BALLS) {
+        memcpy(keyball.balls, req->balls, sizeof(keyball.balls));
+        keyball.cpi_changed = true;
+    }
+#    endif
+    // ack
+    *(uint8_t *)out_data = req->seq;
 }
 
-static void rpc_set_cpi_invoke(void) {
-    if (!keyball.cpi_changed) {
+static void rpc_sync_state_invoke(void) {
+    static uint8_t seq   = 0;
+    uint16_t       dirty = keyball.sync_dirty;
+    if (dirty == 0) {
+        return;
+    }
+    keyball_sync_t req = {
+        .seq             = ++seq,
+        .dirty           = dirty,
+        .cpi             = keyball.cpi_value,
+        .scroll_mode     = keyball.scroll_mode,
+        .scroll_div      = keyball.scroll_div,
+        .have_ball       = keyball.this_have_ball,
+        .scrollsnap_mode = keyball_get_scrollsnap_mode(),
+        .oled_flags      = keyball.oled_flags,
+        .accel_profile   = keyball_get_accel_profile(),
+    };
+    memcpy(req.user, keyball.sync_user, sizeof(req.user));
+#    ifdef KEYBALL_BALL_CONFIG_ENABLE
+    memcpy(req.balls, keyball.balls, sizeof(req.balls));
+#    endif
+    uint8_t ack = 0;
+    if (!link_exec(KEYBALL_LINK_SYNC_STATE, KEYBALL_SYNC_STATE, sizeof(req), &req, sizeof(ack), &ack)) {
         return;
     }
-    keyball_cpi_t req = keyball.cpi_value;
-    if (!transaction_rpc_send(KEYBALL_SET_CPI, sizeof(req), &req)) {
+    if (ack != req.seq) {
+        link_reject(KEYBALL_LINK_SYNC_STATE, true);
         return;
     }
-    keyball.cpi_changed = false;
+    // clear only sent bits, others may be marked while sending.
+    keyball.sync_dirty &= ~dirty;
 }
 
 #endif
@@ -511,6 +1820,57 @@ void keyball_oled_render_layerinfo(void) {
 #endif
 }
 
+void keyball_oled_render_linkinfo(void) {
+#if defined(OLED_ENABLE) && defined(KEYBALL_LINK_STATS_ENABLE)
+    // Format: `Link:TX{attempts} ER{failures}` and
+    //         `RTT :{rtt min}{rtt avg}{rtt max}`
+    //
+    // Output example:
+    //
+    //     Link:TX 1234 ER    0
+    //     RTT :  101  105  240
+    keyball_link_stats_t st = {0};
+    keyball_get_link_stats(KEYBALL_LINK_GET_MOTION, &st);
+
+    oled_write_P(PSTR("Link\xB1TX"), false);
+    oled_write(format_5u(st.attempts), false);
+    oled_write_P(PSTR(" ER"), false);
+    oled_write(format_5u(st.failures), false);
+    oled_write_char(' ', false);
+
+    oled_write_P(PSTR("RTT \xB1"), false);
+    oled_write(format_5u(st.rtt_min), false);
+    oled_write(format_5u(st.rtt_avg), false);
+    oled_write(format_5u(st.rtt_max), false);
+    oled_write_char(' ', false);
+#endif
+}
+
+void keyball_oled_render_profile(void) {
+#if defined(OLED_ENABLE) && defined(KEYBALL_PROFILE_ENABLE)
+    // Format: `{label}{avg}` for each phase, 3 phases in a line, and maximum
+    //         of the loop at last.
+    //
+    // Output example:
+    //
+    //     LP  812SC  240DB   31
+    //     TX  102SN   84PU    3
+    //     OL 1630MX 4120
+    static const char labels[] PROGMEM = "LPSCDBTXSNPUOL";
+    keyball_phase_stats_t st           = {0};
+    for (uint8_t i = 0; i < KEYBALL_PHASE_COUNT; i++) {
+        keyball_get_profile(i, &st);
+        oled_write_char(pgm_read_byte(&labels[i * 2]), false);
+        oled_write_char(pgm_read_byte(&labels[i * 2 + 1]), false);
+        oled_write(format_5u(st.avg), false);
+    }
+    keyball_get_profile(KEYBALL_PHASE_LOOP, &st);
+    oled_write_P(PSTR("MX"), false);
+    oled_write(format_5u(st.max), false);
+    oled_write_P(PSTR("       "), false);
+#endif
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Public API functions
 
@@ -521,6 +1881,7 @@ bool keyball_get_scroll_mode(void) {
 void keyball_set_scroll_mode(bool mode) {
     if (mode != keyball.scroll_mode) {
         keyball.scroll_mode_changed = timer_read32();
+        keyball.sync_dirty |= KEYBALL_SYNC_SCROLL;
     }
     keyball.scroll_mode = mode;
 }
@@ -536,6 +1897,63 @@ keyball_scrollsnap_mode_t keyball_get_scrollsnap_mode(void) {
 void keyball_set_scrollsnap_mode(keyball_scrollsnap_mode_t mode) {
 #if KEYBALL_SCROLLSNAP_ENABLE == 2
     keyball.scrollsnap_mode = mode;
+    keyball.sync_dirty |= KEYBALL_SYNC_SCROLLSNAP;
+#endif
+}
+
+uint16_t keyball_report_latency_get(uint8_t bucket) {
+#ifdef DEBUG_KEYBALL_REPORT_LATENCY
+    return bucket < KEYBALL_LATENCY_BUCKETS ? latency_hist[bucket] : 0;
+#else
+    return 0;
+#endif
+}
+
+uint8_t keyball_get_accel_profile(void) {
+#ifdef KEYBALL_POINTER_ACCEL_ENABLE
+    return keyball.accel_profile;
+#else
+    return 0;
+#endif
+}
+
+void keyball_set_accel_profile(uint8_t profile) {
+#ifdef KEYBALL_POINTER_ACCEL_ENABLE
+    profile = profile < KEYBALL_ACCEL_PROFILE_COUNT ? profile : 0;
+    if (keyball.accel_profile != profile) {
+        keyball.accel_profile = profile;
+        keyball.sync_dirty |= KEYBALL_SYNC_ACCEL;
+    }
+#endif
+}
+
+#ifdef KEYBALL_BALL_CONFIG_EEPROM
+// ball_config_valid tells whether config read from EEPROM is in range and
+// has no unknown bits, which an erased or old datablock may have.
+static bool ball_config_valid(keyball_ball_config_t c) {
+    keyball_ball_config_t known = {.cpi = c.cpi, .role = c.role, .axis = c.axis, .sdiv = c.sdiv};
+    return known.raw == c.raw && c.cpi <= CPI_MAX && c.sdiv <= SCROLL_DIV_MAX;
+}
+#endif
+
+keyball_ball_config_t keyball_get_ball_config(keyball_ball_t ball) {
+    return ball_config(ball == KEYBALL_BALL_LEFT);
+}
+
+void keyball_set_ball_config(keyball_ball_t ball, keyball_ball_config_t config) {
+#ifdef KEYBALL_BALL_CONFIG_ENABLE
+    if (ball >= KEYBALL_BALL_COUNT) {
+        return;
+    }
+    if (config.cpi > CPI_MAX) {
+        config.cpi = CPI_MAX;
+    }
+    if (config.sdiv > SCROLL_DIV_MAX) {
+        config.sdiv = SCROLL_DIV_MAX;
+    }
+    keyball.balls[ball] = config;
+    keyball.sync_dirty |= KEYBALL_SYNC_BALLS;
+    apply_cpi();
 #endif
 }
 
@@ -545,6 +1963,114 @@ uint8_t keyball_get_scroll_div(void) {
 
 void keyball_set_scroll_div(uint8_t div) {
     keyball.scroll_div = div > SCROLL_DIV_MAX ? SCROLL_DIV_MAX : div;
+    keyball.sync_dirty |= KEYBALL_SYNC_SCROLL;
+}
+
+bool keyball_get_link_stats(keyball_link_t link, keyball_link_stats_t *stats) {
+#if defined(SPLIT_KEYBOARD) && defined(KEYBALL_LINK_STATS_ENABLE)
+    if (link >= KEYBALL_LINK_COUNT) {
+        return false;
+    }
+    const link_stats_t *s = &link_stats[link];
+    uint16_t            n = s->attempts - s->failures;
+    stats->attempts       = s->attempts;
+    stats->failures       = s->failures;
+    stats->retries        = s->retries;
+    stats->rtt_min        = s->rtt_min;
+    stats->rtt_avg        = n > 0 ? s->rtt_sum / n : 0;
+    stats->rtt_max        = s->rtt_max;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool keyball_raw_hid_link_stats(uint8_t *data, uint8_t length) {
+#if defined(KEYBALL_LINK_STATS_ENABLE) && defined(RAW_ENABLE)
+    keyball_link_stats_t st = {0};
+    if (length < 2 + sizeof(st) || data[0] != KEYBALL_RAW_HID_LINK_STATS) {
+        return false;
+    }
+    if (is_keyboard_master() && keyball_get_link_stats(data[1], &st)) {
+        const uint16_t v[] = {st.attempts, st.failures, st.retries, st.rtt_min, st.rtt_avg, st.rtt_max};
+        for (uint8_t i = 0; i < sizeof(v) / sizeof(v[0]); i++) {
+            data[2 + i * 2]     = v[i] & 0xff;
+            data[2 + i * 2 + 1] = v[i] >> 8;
+        }
+    } else {
+        data[1] = 0xff; // unavailable
+    }
+    raw_hid_send(data, length);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool keyball_get_profile(keyball_phase_t phase, keyball_phase_stats_t *stats) {
+#ifdef KEYBALL_PROFILE_ENABLE
+    if (phase >= KEYBALL_PHASE_COUNT) {
+        return false;
+    }
+    const phase_stats_t *s = &phase_stats[phase];
+    stats->count           = s->count;
+    stats->min             = s->min;
+    stats->avg             = s->count > 0 ? s->sum / s->count : 0;
+    stats->max             = s->max;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool keyball_raw_hid_profile(uint8_t *data, uint8_t length) {
+#if defined(KEYBALL_PROFILE_ENABLE) && defined(RAW_ENABLE)
+    keyball_phase_stats_t st = {0};
+    if (length < 2 + sizeof(st) || data[0] != KEYBALL_RAW_HID_PROFILE) {
+        return false;
+    }
+    if (keyball_get_profile(data[1], &st)) {
+        const uint16_t v[] = {st.count, st.min, st.avg, st.max};
+        for (uint8_t i = 0; i < sizeof(v) / sizeof(v[0]); i++) {
+            data[2 + i * 2]     = v[i] & 0xff;
+            data[2 + i * 2 + 1] = v[i] >> 8;
+        }
+    } else {
+        data[1] = 0xff; // unavailable
+    }
+    raw_hid_send(data, length);
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if defined(VIA_ENABLE) && (defined(KEYBALL_LINK_STATS_ENABLE) || defined(KEYBALL_PROFILE_ENABLE))
+bool via_command_kb(uint8_t *data, uint8_t length) {
+    return keyball_raw_hid_link_stats(data, length) || keyball_raw_hid_profile(data, length);
+}
+#endif
+
+uint8_t keyball_get_oled_flags(void) {
+    return keyball.oled_flags;
+}
+
+void keyball_set_oled_flags(uint8_t flags) {
+    if (flags != keyball.oled_flags) {
+        keyball.oled_flags = flags;
+        keyball.sync_dirty |= KEYBALL_SYNC_OLED;
+    }
+}
+
+uint8_t keyball_get_sync_user(uint8_t index) {
+    return index < KEYBALL_SYNC_USER_SIZE ? keyball.sync_user[index] : 0;
+}
+
+void keyball_set_sync_user(uint8_t index, uint8_t value) {
+    if (index < KEYBALL_SYNC_USER_SIZE && keyball.sync_user[index] != value) {
+        keyball.sync_user[index] = value;
+        keyball.sync_dirty |= KEYBALL_SYNC_USER;
+    }
 }
 
 uint8_t keyball_get_cpi(void) {
@@ -555,11 +2081,9 @@ void keyball_set_cpi(uint8_t cpi) {
     if (cpi > CPI_MAX) {
         cpi = CPI_MAX;
     }
-    keyball.cpi_value   = cpi;
-    keyball.cpi_changed = true;
-    if (keyball.this_have_ball) {
-        pmw3360_cpi_set(cpi == 0 ? CPI_DEFAULT - 1 : cpi - 1);
-    }
+    keyball.cpi_value = cpi;
+    keyball.sync_dirty |= KEYBALL_SYNC_CPI;
+    apply_cpi();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -574,7 +2098,7 @@ void keyboard_post_init_kb(void) {
     if (!is_keyboard_master()) {
         transaction_register_rpc(KEYBALL_GET_INFO, rpc_get_info_handler);
         transaction_register_rpc(KEYBALL_GET_MOTION, rpc_get_motion_handler);
-        transaction_register_rpc(KEYBALL_SET_CPI, rpc_set_cpi_handler);
+        transaction_register_rpc(KEYBALL_SYNC_STATE, rpc_sync_state_handler);
     }
 #endif
 
@@ -589,25 +2113,53 @@ void keyboard_post_init_kb(void) {
 #endif
 #if KEYBALL_SCROLLSNAP_ENABLE == 2
         keyball_set_scrollsnap_mode(c.ssnap);
+#endif
+#ifdef KEYBALL_BALL_CONFIG_EEPROM
+        eeconfig_read_kb_datablock(keyball.balls);
+        // reset invalid config to the default, which follows global ones.
+        for (uint8_t i = 0; i < KEYBALL_BALL_COUNT; i++) {
+            if (!ball_config_valid(keyball.balls[i])) {
+                keyball.balls[i] = (keyball_ball_config_t){0};
+            }
+        }
+        keyball.sync_dirty |= KEYBALL_SYNC_BALLS;
+        apply_cpi();
 #endif
         keyball_keyboard_post_init_eeconfig_user(c.raw);
     }
 
-    keyball_on_adjust_layout(KEYBALL_ADJUST_PENDING);
+    adjust_layout(KEYBALL_ADJUST_PENDING);
     keyboard_post_init_user();
 }
 
-#if SPLIT_KEYBOARD
 void housekeeping_task_kb(void) {
+#if defined(KEYBALL_PROFILE_ENABLE) && defined(OLED_ENABLE)
+    if (oled_run) {
+        keyball_profile_end(KEYBALL_PHASE_OLED, oled_since);
+        oled_run = false;
+    }
+#endif
+    boot_task();
+#ifdef SPLIT_KEYBOARD
     if (is_keyboard_master()) {
+        KEYBALL_PROFILE_BEGIN(since);
         rpc_get_info_invoke();
+        if (keyball.that_enable) {
+            rpc_sync_state_invoke();
+        }
         if (keyball.that_have_ball) {
             rpc_get_motion_invoke();
-            rpc_set_cpi_invoke();
         }
+        KEYBALL_PROFILE_END(KEYBALL_PHASE_TRANSPORT, since);
     }
-}
 #endif
+#if defined(KEYBALL_IDLE_SLEEP) && defined(__AVR__)
+    idle_task();
+#endif
+#ifdef KEYBALL_PROFILE_ENABLE
+    profile_pass();
+#endif
+}
 
 static void pressing_keys_update(uint16_t keycode, keyrecord_t *record) {
     // Process only valid keycodes.
@@ -647,6 +2199,16 @@ bool process_record_kb(uint16_t keycode, keyrecord_t *record) {
     // store last keycode, row, and col for OLED
     keyball.last_kc  = keycode;
     keyball.last_pos = record->event.key;
+#ifdef KEYBALL_KINETIC_SCROLL_ENABLE
+    // any key stops kinetic scroll.
+    if (record->event.pressed) {
+        kinetic_stop();
+    }
+#endif
+    if (keyball.boot_first_key == 0 && record->event.pressed) {
+        keyball.boot_first_key = boot_time();
+        dprintf("keyball: first key at %u\n", keyball.boot_first_key);
+    }
 
     pressing_keys_update(keycode, record);
 
@@ -684,6 +2246,8 @@ bool process_record_kb(uint16_t keycode, keyrecord_t *record) {
             case KBC_RST:
                 keyball_set_cpi(0);
                 keyball_set_scroll_div(0);
+                keyball_set_ball_config(KEYBALL_BALL_LEFT, (keyball_ball_config_t){0});
+                keyball_set_ball_config(KEYBALL_BALL_RIGHT, (keyball_ball_config_t){0});
 #ifdef POINTING_DEVICE_AUTO_MOUSE_ENABLE
                 set_auto_mouse_enable(false);
                 set_auto_mouse_timeout(AUTO_MOUSE_TIME);
@@ -703,6 +2267,9 @@ bool process_record_kb(uint16_t keycode, keyrecord_t *record) {
                 };
                 c.raw = keyball_process_record_eeconfig_user(c.raw);
                 eeconfig_update_kb(c.raw);
+#ifdef KEYBALL_BALL_CONFIG_EEPROM
+                eeconfig_update_kb_datablock(keyball.balls);
+#endif
             } break;
 
             case CPI_I100:
@@ -758,6 +2325,12 @@ bool process_record_kb(uint16_t keycode, keyrecord_t *record) {
                 break;
 #endif
 
+#ifdef KEYBALL_POINTER_ACCEL_ENABLE
+            case ACCL_NXT:
+                keyball_set_accel_profile(keyball_get_accel_profile() + 1);
+                break;
+#endif
+
             default:
                 return true;
         }
@@ -32,6 +32,205 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #    define KEYBALL_REPORTMOUSE_INTERVAL 8 // mouse report rate: 125Hz
 #endif
 
+/// KEYBALL_MOTION_CARRYOVER keeps the excess of trackball motion, which
+/// doesn't fit into a mouse report, and sends it by following reports.
+/// Without this, fast motion over 127 counts per report is dropped.
+/// Additionally, define MOUSE_EXTENDED_REPORT to send 16-bit motion to the
+/// host, then the excess rarely happens.
+//#define KEYBALL_MOTION_CARRYOVER
+
+/// KEYBALL_MOTION_PACING makes the secondary tag its motion with timing of
+/// sensor reads: span between the first and the last read, age of the last
+/// read, and count of reads.  The primary distributes received motion
+/// linearly over reports according to the timing, instead of reporting it
+/// at once.  It smooths the ball on the secondary, especially with two balls.
+/// It delays motion of the secondary up to KEYBALL_MOTION_PACING_MAX_SPAN.
+//#define KEYBALL_MOTION_PACING
+
+/// Maximum duration in milliseconds to distribute a motion packet, for
+/// KEYBALL_MOTION_PACING.
+#ifndef KEYBALL_MOTION_PACING_MAX_SPAN
+#    define KEYBALL_MOTION_PACING_MAX_SPAN 8
+#endif
+
+/// KEYBALL_OFFLOAD_TRANSFORM makes the secondary transform motion of its ball
+/// into mouse move or scroll: scroll division, scroll snap, pointer
+/// acceleration, kinetic scroll and keyball_on_apply_motion_to_mouse_*()
+/// hooks.  Then the primary just adds it to reports, which saves cycles of
+/// the primary for heavy keymaps.  The excess of reports is always carried
+/// over.  It cannot be used with KEYBALL_MOTION_PACING.
+//#define KEYBALL_OFFLOAD_TRANSFORM
+
+/// KEYBALL_BALL_CONFIG_ENABLE enables configuration for each ball: CPI, role,
+/// axis transform and scroll divider.  See keyball_set_ball_config().  It is
+/// mirrored to the secondary, and saved to EEPROM by KBC_SAVE when
+/// EECONFIG_KB_DATA_SIZE is defined as KEYBALL_BALL_CONFIG_SIZE (4) in
+/// config.h.
+//#define KEYBALL_BALL_CONFIG_ENABLE
+
+/// PMW3360_COUNT specifies count of optical sensors on each half, which
+/// share the SPI bus.  The sensor 0 is the main ball, and others are sub
+/// balls which always scroll.  Sensors are read in round robin, one for each
+/// pass.  Define PMW3360_NCS_PINS (and PMW3360_MOTION_PINS) too, see
+/// drivers/pmw3360/pmw3360.h.
+//#define PMW3360_COUNT 2
+#ifndef PMW3360_COUNT
+#    define PMW3360_COUNT 1
+#endif
+
+#if defined(KEYBALL_OFFLOAD_TRANSFORM) && defined(KEYBALL_MOTION_PACING)
+#    error KEYBALL_OFFLOAD_TRANSFORM cannot be used with KEYBALL_MOTION_PACING
+#endif
+
+// KEYBALL_MOTION_SCROLL is defined when motion packets of the secondary carry
+// scroll: a report of KEYBALL_OFFLOAD_TRANSFORM, or motion of sub balls.
+#if defined(KEYBALL_OFFLOAD_TRANSFORM) || PMW3360_COUNT > 1
+#    define KEYBALL_MOTION_SCROLL
+#endif
+
+/// Pointer acceleration and kinetic scroll measure velocity of the ball in
+/// counts per KEYBALL_VELOCITY_PERIOD milliseconds.  It is normalized by time
+/// between mouse reports, so they work same regardless of the report rate.
+#ifndef KEYBALL_VELOCITY_PERIOD
+#    define KEYBALL_VELOCITY_PERIOD 8
+#endif
+
+/// KEYBALL_POINTER_ACCEL_ENABLE enables pointer acceleration.  The gain of
+/// pointer motion changes by velocity along with a curve of the current
+/// profile, which is selected by ACCL_NXT keycode or
+/// keyball_set_accel_profile().  It allows to use low CPI for precision
+/// while keeping fast traversal.
+//#define KEYBALL_POINTER_ACCEL_ENABLE
+
+/// Curves of pointer acceleration profiles, as `offset, slope, limit`.
+///
+/// The gain is 1.0 while velocity index is up to offset, then it increases
+/// slope/256 for each index, up to limit/256.  The velocity index is counts
+/// per KEYBALL_VELOCITY_PERIOD shifted right by KEYBALL_ACCEL_VELOCITY_SHIFT,
+/// and it is clipped to 31.  The curves are expanded to tables at compile time.
+#ifndef KEYBALL_ACCEL_PROFILE_0
+#    define KEYBALL_ACCEL_PROFILE_0 0, 0, 256 // linear
+#endif
+#ifndef KEYBALL_ACCEL_PROFILE_1
+#    define KEYBALL_ACCEL_PROFILE_1 2, 16, 512 // mild, up to x2
+#endif
+#ifndef KEYBALL_ACCEL_PROFILE_2
+#    define KEYBALL_ACCEL_PROFILE_2 1, 32, 768 // medium, up to x3
+#endif
+#ifndef KEYBALL_ACCEL_PROFILE_3
+#    define KEYBALL_ACCEL_PROFILE_3 1, 64, 1024 // strong, up to x4
+#endif
+
+#ifndef KEYBALL_ACCEL_VELOCITY_SHIFT
+#    define KEYBALL_ACCEL_VELOCITY_SHIFT 2
+#endif
+
+/// High resolution scroll is enabled by POINTING_DEVICE_HIRES_SCROLL_ENABLE
+/// of QMK, which advertises the resolution multiplier in the mouse
+/// descriptor.  Then scroll is reported by 1/KEYBALL_SCROLL_HIRES_RESOLUTION
+/// notches, and scroll divider works as same as normal scroll.  Define
+/// MOUSE_SCROLL_EXTENDED_REPORT too, to avoid clipping of fast scroll.
+///
+/// Please note that it requires QMK 0.24.0 or later.
+#ifdef POINTING_DEVICE_HIRES_SCROLL_ENABLE
+#    ifndef KEYBALL_SCROLL_HIRES_RESOLUTION
+#        ifndef POINTING_DEVICE_HIRES_SCROLL_MULTIPLIER
+#            error POINTING_DEVICE_HIRES_SCROLL_ENABLE requires QMK 0.24.0 or later
+#        endif
+// Define this explicitly when POINTING_DEVICE_HIRES_SCROLL_EXPONENT is not 0.
+#        define KEYBALL_SCROLL_HIRES_RESOLUTION POINTING_DEVICE_HIRES_SCROLL_MULTIPLIER
+#    endif
+#endif
+
+/// KEYBALL_KINETIC_SCROLL_ENABLE enables kinetic (momentum) scroll.  When
+/// the ball is released quickly in scroll mode, scroll continues with
+/// decaying velocity.  It stops by any key press or opposite ball motion.
+//#define KEYBALL_KINETIC_SCROLL_ENABLE
+
+/// Count of recent reports to estimate velocity of the ball at release.  The
+/// ball is released when no motion arrives for KEYBALL_VELOCITY_PERIOD.
+#ifndef KEYBALL_KINETIC_SCROLL_SAMPLES
+#    define KEYBALL_KINETIC_SCROLL_SAMPLES 4
+#endif
+
+/// Minimum velocity (counts per KEYBALL_VELOCITY_PERIOD) at release to start
+/// kinetic scroll.
+#ifndef KEYBALL_KINETIC_SCROLL_THRESHOLD
+#    define KEYBALL_KINETIC_SCROLL_THRESHOLD 16
+#endif
+
+/// Friction of kinetic scroll: velocity decreases by friction/256 for each
+/// KEYBALL_VELOCITY_PERIOD.
+#ifndef KEYBALL_KINETIC_SCROLL_FRICTION
+#    define KEYBALL_KINETIC_SCROLL_FRICTION 8
+#endif
+
+/// Kinetic scroll stops when velocity (counts per KEYBALL_VELOCITY_PERIOD)
+/// becomes less than this cut-off.
+#ifndef KEYBALL_KINETIC_SCROLL_CUTOFF
+#    define KEYBALL_KINETIC_SCROLL_CUTOFF 1
+#endif
+
+/// KEYBALL_REPORTMOUSE_ADAPTIVE sends a mouse report as soon as motion
+/// exists and the host has taken the previous report, instead of throttling
+/// by KEYBALL_REPORTMOUSE_INTERVAL.  Reports are coalesced only while the USB
+/// endpoint is busy, so it follows the polling rate of the host up to
+/// 1000Hz.  Motion of sub balls, scroll of the secondary and coasting of
+/// kinetic scroll are sent so too.  KEYBALL_REPORTMOUSE_INTERVAL is still
+/// used while no motion exists.
+//#define KEYBALL_REPORTMOUSE_ADAPTIVE
+
+/// Minimum interval of mouse reports in milliseconds, for
+/// KEYBALL_REPORTMOUSE_ADAPTIVE.
+#ifndef KEYBALL_REPORTMOUSE_MIN_INTERVAL
+#    define KEYBALL_REPORTMOUSE_MIN_INTERVAL 1
+#endif
+
+/// KEYBALL_IDLE_SLEEP makes the CPU sleep between passes of the main loop,
+/// after no keys are held and no motion exists for this milliseconds.  The
+/// CPU is woken by the next interrupt, at the latest by the timer tick in a
+/// millisecond, so the main loop runs at about 1kHz while idle.  Full rate
+/// scanning resumes at the first pass which sees a key or motion.  This works
+/// only on AVR.
+///
+/// It only throttles the main loop, and power saving isn't measured.  The
+/// tick keeps running for timer_read(), and keys can't wake the CPU by
+/// themselves, because some column lines (C6, D4 and D7) have neither INTn
+/// nor PCINT.
+//#define KEYBALL_IDLE_SLEEP 1000
+
+/// DEBUG_KEYBALL_REPORT_LATENCY enables a histogram of latency from arrival
+/// of motion to a mouse report.  It enables keyball_report_latency_get().
+/// Additionally, it will be logged each second when defined CONSOLE_ENABLE
+/// and `debug_enable = true`.
+//#define DEBUG_KEYBALL_REPORT_LATENCY
+
+/// KEYBALL_LINK_STATS_ENABLE enables telemetry of keyball's split
+/// transactions: attempts, failures, retries and round-trip time.  It enables
+/// keyball_get_link_stats() and keyball_oled_render_linkinfo(), and the stats
+/// can be read over raw HID.  See also KEYBALL_RAW_HID_LINK_STATS.
+//#define KEYBALL_LINK_STATS_ENABLE
+
+/// Command ID of raw HID to read stats of split transactions.  It must not
+/// conflict with VIA's command IDs.
+#ifndef KEYBALL_RAW_HID_LINK_STATS
+#    define KEYBALL_RAW_HID_LINK_STATS 0xA1
+#endif
+
+/// KEYBALL_PROFILE_ENABLE enables a profiler of phases in the main loop.  It
+/// measures each phase by Timer0 in microseconds, and keeps minimum, average
+/// and maximum of the time spent by each pass of the main loop.  See
+/// keyball_phase_t for phases.  It enables keyball_get_profile() and
+/// keyball_oled_render_profile(), and the stats can be read over raw HID.
+/// See also KEYBALL_RAW_HID_PROFILE.  Nothing is measured without this.
+//#define KEYBALL_PROFILE_ENABLE
+
+/// Command ID of raw HID to read stats of the profiler.  It must not conflict
+/// with VIA's command IDs.
+#ifndef KEYBALL_RAW_HID_PROFILE
+#    define KEYBALL_RAW_HID_PROFILE 0xA2
+#endif
+
 #ifndef KEYBALL_SCROLLBALL_INHIVITOR
 #    define KEYBALL_SCROLLBALL_INHIVITOR 50
 #endif
@@ -49,10 +248,27 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #    define KEYBALL_SCROLLSNAP_TENSION_THRESHOLD 12
 #endif
 
+/// KEYBALL_MOTION_FLAG_COL enables the motion flag of the secondary, which
+/// is raised while its ball has motion, and the primary fetches motion only
+/// when it is raised.  It and KEYBALL_MOTION_FLAG_ROW specify a position in
+/// the matrix of each half, which isn't used by any keys.  The flag is carried
+/// by the matrix sync out of band of the matrix, so it requires duplexmatrix:
+/// it never passes debounce, nor counts as activity.  Without it, the primary
+/// polls motion each KEYBALL_TX_GETMOTION_INTERVAL.
+//#define KEYBALL_MOTION_FLAG_COL 7
+#ifndef KEYBALL_MOTION_FLAG_ROW
+#    define KEYBALL_MOTION_FLAG_ROW 0
+#endif
+
 /// Specify SROM ID to be uploaded PMW3360DW (optical sensor).  It will be
 /// enabled high CPI setting or so.  Valid valus are 0x04 or 0x81.  Define this
 /// in your config.h to be enable.  Please note that using this option will
 /// increase the firmware size by more than 4KB.
+///
+/// The SROM images can't be made smaller by compression: they are 4094 bytes
+/// of almost 8 bits/byte entropy.  deflate saves only 156 bytes (0x04) and
+/// 312 bytes (0x81), which is less than the size of a decoder, and small
+/// window LZ or RLE expand them.
 //#define KEYBALL_PMW3360_UPLOAD_SROM_ID 0x04
 //#define KEYBALL_PMW3360_UPLOAD_SROM_ID 0x81
 
@@ -68,9 +284,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //////////////////////////////////////////////////////////////////////////////
 // Constants
 
-#define KEYBALL_TX_GETINFO_INTERVAL 500
-#define KEYBALL_TX_GETINFO_MAXTRY 10
-#define KEYBALL_TX_GETMOTION_INTERVAL 4
+#define KEYBALL_TX_GETINFO_INTERVAL_MIN 2   // first backoff of negotiation
+#define KEYBALL_TX_GETINFO_INTERVAL_MAX 512 // backoff doubles up to this
+#define KEYBALL_TX_GETINFO_TIMEOUT 5000     // regard the secondary as absent
+#ifdef KEYBALL_MOTION_FLAG_COL
+#    define KEYBALL_TX_GETMOTION_INTERVAL 1 // only while the motion flag is raised
+#else
+#    define KEYBALL_TX_GETMOTION_INTERVAL 4
+#endif
 
 #if (PRODUCT_ID & 0xff00) == 0x0000
 #    define KEYBALL_MODEL 46
@@ -86,6 +307,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define KEYBALL_OLED_MAX_PRESSING_KEYCODES 6
 
+#define KEYBALL_ACCEL_PROFILE_COUNT 4
+
+#define KEYBALL_BALL_COUNT 2
+#define KEYBALL_BALL_CONFIG_SIZE 4 // sizeof(keyball_ball_config_t) * KEYBALL_BALL_COUNT
+
+#if defined(KEYBALL_BALL_CONFIG_ENABLE) && defined(EECONFIG_KB_DATA_SIZE) && EECONFIG_KB_DATA_SIZE == KEYBALL_BALL_CONFIG_SIZE
+#    define KEYBALL_BALL_CONFIG_EEPROM
+#endif
+
+#define KEYBALL_SYNC_USER_SIZE 4
+
+#define KEYBALL_LATENCY_BUCKETS 16
+#define KEYBALL_LATENCY_BUCKET_US 500
+
 //////////////////////////////////////////////////////////////////////////////
 // Types
 
@@ -115,6 +350,10 @@ enum keyball_keycodes {
     AML_I50  = QK_KB_11, // Increment automatic mouse layer timeout
     AML_D50  = QK_KB_12, // Decrement automatic mouse layer timeout
 
+    // Pointer acceleration control keycode.
+    // Only works when KEYBALL_POINTER_ACCEL_ENABLE is defined.
+    ACCL_NXT = QK_KB_16, // Select next pointer acceleration profile
+
     // User customizable 32 keycodes.
     KEYBALL_SAFE_RANGE = QK_USER_0,
 };
@@ -135,7 +374,8 @@ typedef union {
 } keyball_config_t;
 
 typedef struct {
-    uint8_t ballcnt; // count of balls: support only 0 or 1, for now
+    uint8_t ballcnt; // count of balls which are ready, up to PMW3360_COUNT
+    bool    booting; // ball is initializing, ask again later
 } keyball_info_t;
 
 typedef struct {
@@ -143,7 +383,144 @@ typedef struct {
     int16_t y;
 } keyball_motion_t;
 
-typedef uint8_t keyball_cpi_t;
+// keyball_motion_packet_t is motion which is sent from the secondary.  The
+// excess over int8_t follows in next packets.
+typedef struct {
+    int8_t x;
+    int8_t y;
+#ifdef KEYBALL_MOTION_SCROLL
+    int8_t h; // x and y are of mouse move, h and v are of scroll
+    int8_t v;
+#endif
+#ifdef KEYBALL_MOTION_PACING
+    uint8_t span;  // milliseconds from the first sensor read to the last one
+    uint8_t age;   // milliseconds from the last sensor read to this packet
+    uint8_t count; // count of sensor reads
+#endif
+} keyball_motion_packet_t;
+
+// Split transactions of keyball, which have stats.
+typedef enum {
+    KEYBALL_LINK_GET_INFO = 0,
+    KEYBALL_LINK_GET_MOTION,
+    KEYBALL_LINK_SYNC_STATE,
+    KEYBALL_LINK_COUNT,
+} keyball_link_t;
+
+// keyball_link_stats_t is stats of a split transaction.  Round-trip times are
+// in microseconds, and count only succeeded transactions.
+typedef struct {
+    uint16_t attempts;
+    uint16_t failures;
+    uint16_t retries; // attempts which follow a failed or rejected one
+    uint16_t rtt_min;
+    uint16_t rtt_avg;
+    uint16_t rtt_max;
+} keyball_link_stats_t;
+
+// keyball_phase_t is a phase of the main loop, which is measured by
+// KEYBALL_PROFILE_ENABLE.  SCAN and DEBOUNCE are measured only on boards with
+// the duplex matrix, otherwise they are included in LOOP only.
+typedef enum {
+    KEYBALL_PHASE_LOOP,          // a whole pass of the main loop
+    KEYBALL_PHASE_SCAN,          // matrix scan
+    KEYBALL_PHASE_DEBOUNCE,      // debounce of the matrix
+    KEYBALL_PHASE_TRANSPORT,     // split transport: the matrix and RPCs
+    KEYBALL_PHASE_SENSOR,        // motion read of optical sensors
+    KEYBALL_PHASE_POINTING_USER, // pointing_device_task_user()
+    KEYBALL_PHASE_OLED,          // OLED rendering and I2C transfer
+    KEYBALL_PHASE_COUNT,
+} keyball_phase_t;
+
+// keyball_phase_stats_t is stats of a phase in microseconds, for passes of
+// the main loop which run the phase.
+typedef struct {
+    uint16_t count;
+    uint16_t min;
+    uint16_t avg;
+    uint16_t max;
+} keyball_phase_stats_t;
+
+#ifdef KEYBALL_PROFILE_ENABLE
+uint32_t keyball_profile_begin(void);
+void     keyball_profile_end(keyball_phase_t phase, uint32_t since);
+
+// KEYBALL_PROFILE_BEGIN and KEYBALL_PROFILE_END measure a phase between
+// them.  They are expanded to nothing without KEYBALL_PROFILE_ENABLE.
+#    define KEYBALL_PROFILE_BEGIN(since) uint32_t since = keyball_profile_begin()
+#    define KEYBALL_PROFILE_END(phase, since) keyball_profile_end(phase, since)
+#else
+#    define KEYBALL_PROFILE_BEGIN(since)
+#    define KEYBALL_PROFILE_END(phase, since)
+#endif
+
+// Bits of dirty fields in keyball_sync_t.  Fields are allocated from the
+// lowest bit and events from the highest one.
+enum {
+    KEYBALL_SYNC_CPI        = 0x0001,
+    KEYBALL_SYNC_SCROLL     = 0x0002, // scroll mode, scroll divider and have_ball
+    KEYBALL_SYNC_SCROLLSNAP = 0x0004,
+    KEYBALL_SYNC_OLED       = 0x0008,
+    KEYBALL_SYNC_USER       = 0x0010,
+    KEYBALL_SYNC_BALLS      = 0x0020,
+    KEYBALL_SYNC_ACCEL      = 0x0040,
+    KEYBALL_SYNC_ALL        = 0x007f,
+    KEYBALL_SYNC_KINETIC    = 0x8000, // an event to stop kinetic scroll, not a field
+};
+
+// Balls are identified by side, not by primary or secondary.
+typedef enum {
+    KEYBALL_BALL_LEFT  = 0,
+    KEYBALL_BALL_RIGHT = 1,
+} keyball_ball_t;
+
+typedef enum {
+    KEYBALL_ROLE_AUTO    = 0, // scroll for the secondary's one of two balls, otherwise move
+    KEYBALL_ROLE_MOVE    = 1, // move, and scroll while scroll mode
+    KEYBALL_ROLE_SCROLL  = 2, // scroll, and move while scroll mode
+    KEYBALL_ROLE_GESTURE = 3, // pass motion to keyball_on_apply_motion_to_gesture()
+} keyball_role_t;
+
+// Bits of axis transform, which are applied to counts of the sensor in this
+// order.
+enum {
+    KEYBALL_AXIS_SWAP     = 0x01,
+    KEYBALL_AXIS_INVERT_X = 0x02,
+    KEYBALL_AXIS_INVERT_Y = 0x04,
+};
+
+typedef union {
+    uint16_t raw;
+    struct {
+        uint8_t cpi : 7;  // 0 follows keyball_get_cpi()
+        uint8_t role : 2; // keyball_role_t
+        uint8_t axis : 3; // KEYBALL_AXIS_* bits
+        uint8_t sdiv : 3; // 0 follows keyball_get_scroll_div()
+    };
+} keyball_ball_config_t;
+
+// keyball_sync_t is a state block which is mirrored to the secondary.  Only
+// fields marked in dirty are applied, and the secondary replies seq as ack.
+typedef struct {
+    uint8_t  seq;
+    uint16_t dirty;
+    uint8_t  cpi;
+    bool     scroll_mode;
+    uint8_t  scroll_div;
+    bool     have_ball; // the primary has a ball
+    uint8_t  scrollsnap_mode;
+    uint8_t  oled_flags;
+    uint8_t  user[KEYBALL_SYNC_USER_SIZE];
+    uint8_t  accel_profile;
+#ifdef KEYBALL_BALL_CONFIG_ENABLE
+    keyball_ball_config_t balls[KEYBALL_BALL_COUNT];
+#endif
+} keyball_sync_t;
+
+// Bits of OLED flags.
+enum {
+    KEYBALL_OLED_INVERTED = 0x01,
+};
 
 typedef enum {
     KEYBALL_SCROLLSNAP_MODE_VERTICAL   = 0,
@@ -152,15 +529,38 @@ typedef enum {
 } keyball_scrollsnap_mode_t;
 
 typedef struct {
-    bool this_have_ball;
+    bool this_have_ball; // settled when this_booting becomes false, except Keyball46
+    bool this_booting;   // optical sensor is initializing in background
     bool that_enable;
     bool that_have_ball;
 
+    // Count of sensors which are ready on each side.
+    uint8_t this_ballcnt;
+    uint8_t that_ballcnt;
+
     keyball_motion_t this_motion;
     keyball_motion_t that_motion;
+#if PMW3360_COUNT > 1
+    keyball_motion_t this_sub_motion[PMW3360_COUNT - 1]; // motion of sub balls
+#endif
+#ifdef KEYBALL_MOTION_SCROLL
+    // Scroll which is transformed by secondary, or motion of its sub balls.
+    keyball_motion_t that_scroll;
+#endif
+
+    // Surface quality (SQUAL) and shutter of this side's sensor, which are
+    // updated by each motion burst.
+    uint8_t  this_squal;
+    uint16_t this_shutter;
 
     uint8_t cpi_value;
-    bool    cpi_changed;
+    bool    cpi_changed; // CPI is requested by primary, but not applied yet
+
+    // Dirty bits of state to be synchronized to the secondary.
+    // See keyball_sync_t.
+    uint16_t sync_dirty;
+    uint8_t  sync_user[KEYBALL_SYNC_USER_SIZE];
+    uint8_t  oled_flags;
 
     bool     scroll_mode;
     uint32_t scroll_mode_changed;
@@ -173,6 +573,27 @@ typedef struct {
     keyball_scrollsnap_mode_t scrollsnap_mode;
 #endif
 
+#ifdef KEYBALL_POINTER_ACCEL_ENABLE
+    uint8_t accel_profile;
+#endif
+
+#ifdef KEYBALL_BALL_CONFIG_ENABLE
+    keyball_ball_config_t balls[KEYBALL_BALL_COUNT];
+#endif
+
+    // Boot timings in milliseconds since power on: the optical sensor got
+    // ready, the first key was reported, and the first motion was reported.
+    // 0 means it has not happened yet.
+    uint16_t boot_ball_ready;
+    uint16_t boot_first_key;
+    uint16_t boot_first_motion;
+    uint16_t boot_negotiated; // the first split negotiation completed
+
+    // Duration in milliseconds and count of split negotiations.  The
+    // negotiation runs again when the split link recovers.
+    uint16_t negotiate_time;
+    uint8_t  negotiate_count;
+
     uint16_t       last_kc;
     keypos_t       last_pos;
     report_mouse_t last_mouse;
@@ -195,7 +616,9 @@ extern keyball_t keyball;
 //////////////////////////////////////////////////////////////////////////////
 // Hook points
 
-/// keyball_on_adjust_layout is called when the keyboard layout adjustted
+/// keyball_on_adjust_layout is called when the keyboard layout adjustted.
+/// It is called again with the same value when sensors of this side get
+/// ready, because keyball.this_have_ball is settled at that time.
 void keyball_on_adjust_layout(keyball_adjust_t v);
 
 /// keyball_on_apply_motion_to_mouse_move applies trackball's motion m to r as
@@ -208,6 +631,12 @@ void keyball_on_apply_motion_to_mouse_move(keyball_motion_t *m, report_mouse_t *
 /// You can change the default algorithm by override this function.
 void keyball_on_apply_motion_to_mouse_scroll(keyball_motion_t *m, report_mouse_t *r, bool is_left);
 
+/// keyball_on_apply_motion_to_gesture consumes trackball's motion m, of the
+/// ball whose role is KEYBALL_ROLE_GESTURE.
+/// The default implementation just drops the motion.  Override this to
+/// implement gestures.
+void keyball_on_apply_motion_to_gesture(keyball_motion_t *m, bool is_left);
+
 //////////////////////////////////////////////////////////////////////////////
 // Public API functions
 
@@ -224,6 +653,19 @@ void keyball_oled_render_keyinfo(void);
 /// inactive layers.
 void keyball_oled_render_layerinfo(void);
 
+/// keyball_oled_render_linkinfo renders stats of the transaction which fetches
+/// motion from the secondary, to OLED.  It shows attempts, failures, and
+/// minimum/average/maximum round-trip times in microseconds.
+/// This works only when KEYBALL_LINK_STATS_ENABLE is defined.
+void keyball_oled_render_linkinfo(void);
+
+/// keyball_oled_render_profile renders stats of the profiler to OLED, in 3
+/// lines.  It shows average microseconds of each phase: LP (loop), SC
+/// (scan), DB (debounce), TX (transport), SN (sensor), PU (pointing user)
+/// and OL (OLED), then maximum of the loop as MX.
+/// This works only when KEYBALL_PROFILE_ENABLE is defined.
+void keyball_oled_render_profile(void);
+
 /// keyball_get_scroll_mode gets current scroll mode.
 bool keyball_get_scroll_mode(void);
 
@@ -236,6 +678,27 @@ keyball_scrollsnap_mode_t keyball_get_scrollsnap_mode(void);
 /// keyball_set_scrollsnap_mode change scroll snap mode.
 void keyball_set_scrollsnap_mode(keyball_scrollsnap_mode_t mode);
 
+/// keyball_get_accel_profile gets current pointer acceleration profile.
+/// It always returns 0 when KEYBALL_POINTER_ACCEL_ENABLE is not defined.
+uint8_t keyball_get_accel_profile(void);
+
+/// keyball_set_accel_profile changes pointer acceleration profile.
+/// Valid values are between 0 and KEYBALL_ACCEL_PROFILE_COUNT - 1, and the
+/// curve of each profile is defined by KEYBALL_ACCEL_PROFILE_0 ~ 3.  It is
+/// mirrored to the secondary, which uses it with KEYBALL_OFFLOAD_TRANSFORM.
+void keyball_set_accel_profile(uint8_t profile);
+
+/// keyball_get_ball_config gets configuration of a ball.
+/// It always returns zeros, which mean defaults, when
+/// KEYBALL_BALL_CONFIG_ENABLE is not defined.
+keyball_ball_config_t keyball_get_ball_config(keyball_ball_t ball);
+
+/// keyball_set_ball_config changes configuration of a ball, which overrides
+/// CPI, role, axis and scroll divider only for the ball.  It is applied to
+/// the sensor of the ball directly, so the balls can use different CPI
+/// without rewriting it.
+void keyball_set_ball_config(keyball_ball_t ball, keyball_ball_config_t config);
+
 /// keyball_get_scroll_div gets current scroll divider.
 /// See also keyball_set_scroll_div for the scroll divider's detail.
 uint8_t keyball_get_scroll_div(void);
@@ -271,6 +734,60 @@ uint8_t keyball_get_cpi(void);
 /// to 35 (3500CPI).
 void keyball_set_cpi(uint8_t cpi);
 
+/// keyball_report_latency_get gets count of mouse reports whose latency is in
+/// the bucket, which covers from bucket * KEYBALL_LATENCY_BUCKET_US to
+/// (bucket + 1) * KEYBALL_LATENCY_BUCKET_US microseconds.  The last bucket
+/// includes all larger latencies.
+/// This works only when DEBUG_KEYBALL_REPORT_LATENCY is defined.
+uint16_t keyball_report_latency_get(uint8_t bucket);
+
+/// keyball_get_link_stats gets stats of a split transaction.  It returns false
+/// for an invalid link, or when KEYBALL_LINK_STATS_ENABLE is not defined.
+bool keyball_get_link_stats(keyball_link_t link, keyball_link_stats_t *stats);
+
+/// keyball_raw_hid_link_stats handles a raw HID request of link stats, and
+/// sends the response when it returns true.
+///
+/// Request:  `{KEYBALL_RAW_HID_LINK_STATS, link}`
+/// Response: `{KEYBALL_RAW_HID_LINK_STATS, link, attempts, failures, retries,
+/// rtt_min, rtt_avg, rtt_max}`, where the stats are little endian uint16_t.
+///
+/// It is called from via_command_kb() when VIA is enabled.  Without VIA,
+/// call this from raw_hid_receive() in your keymap.
+bool keyball_raw_hid_link_stats(uint8_t *data, uint8_t length);
+
+/// keyball_get_profile gets stats of a phase of the main loop.  It returns
+/// false for an invalid phase, or when KEYBALL_PROFILE_ENABLE is not defined.
+bool keyball_get_profile(keyball_phase_t phase, keyball_phase_stats_t *stats);
+
+/// keyball_raw_hid_profile handles a raw HID request of the profiler, and
+/// sends the response when it returns true.
+///
+/// Request:  `{KEYBALL_RAW_HID_PROFILE, phase}`
+/// Response: `{KEYBALL_RAW_HID_PROFILE, phase, count, min, avg, max}`, where
+/// the stats are little endian uint16_t.
+///
+/// It is called from via_command_kb() when VIA is enabled.  Without VIA,
+/// call this from raw_hid_receive() in your keymap.
+bool keyball_raw_hid_profile(uint8_t *data, uint8_t length);
+
+/// keyball_get_oled_flags gets OLED flags: KEYBALL_OLED_INVERTED and so on.
+uint8_t keyball_get_oled_flags(void);
+
+/// keyball_set_oled_flags changes OLED flags, which are mirrored to the
+/// secondary.  Keyball itself doesn't apply them to OLED, so keymaps should
+/// apply them on both sides.
+void keyball_set_oled_flags(uint8_t flags);
+
+/// keyball_get_sync_user gets a user byte, which is mirrored to the
+/// secondary.
+uint8_t keyball_get_sync_user(uint8_t index);
+
+/// keyball_set_sync_user changes a user byte, which is mirrored to the
+/// secondary.  Valid indexes are between 0 and KEYBALL_SYNC_USER_SIZE - 1.
+/// Keymaps can synchronize their state by these without own transactions.
+void keyball_set_sync_user(uint8_t index, uint8_t value);
+
 /// keyball_keyboard_post_init_eeconfig_user is called after keyball config
 /// is loaded from EEPROM in keyboard_post_init_kb.
 /// Override this to restore additional user configuration stored in eeconfig.
@@ -32,8 +32,17 @@ const matrix_row_t matrix_mask[MATRIX_ROWS] = {
     0b011111111111,
 };
 
-const uint8_t row3_order_data[] = {
-    0, 1, 2, 3, 9, 8, 7, 6, 5, 4, 10
+// Permutations of rows for the left ball, which mirror the PCB.
+static const duplex_perm_t mirror12 PROGMEM = {
+    DUPLEX_PERM_NIBBLE(11, 10, 9, 8),
+    DUPLEX_PERM_NIBBLE( 7,  6, 5, 4),
+    DUPLEX_PERM_NIBBLE( 3,  2, 1, 0),
+};
+
+static const duplex_perm_t row3_order PROGMEM = {
+    DUPLEX_PERM_NIBBLE( 0,  1,  2, 3),
+    DUPLEX_PERM_NIBBLE( 9,  8,  7, 6),
+    DUPLEX_PERM_NIBBLE( 5,  4, 10, DUPLEX_PERM_NONE),
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -50,19 +59,6 @@ static uint8_t peek_matrix_intersection(pin_t out_pin, pin_t in_pin) {
     return pin_state;
 }
 
-static uint16_t bitrev12(uint16_t bits) {
-    return bitrev16(bits) >> 4;
-}
-
-static uint16_t row3_order(uint16_t bits) {
-    uint16_t r = 0;
-    for (int i = 0; i < sizeof(row3_order_data) / sizeof(row3_order_data[0]); i++) {
-        uint8_t shift = row3_order_data[i];
-        r |= ((bits & (1 << shift)) >> shift) << i;
-    }
-    return r;
-}
-
 static bool isLeftBall = false;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -79,10 +75,10 @@ void keyboard_pre_init_kb(void) {
 
 void duplex_scan_raw_post_kb(matrix_row_t out_matrix[]) {
     if (isLeftBall) {
-        out_matrix[0] = bitrev12(out_matrix[0]);
-        out_matrix[1] = bitrev12(out_matrix[1]);
-        out_matrix[2] = bitrev12(out_matrix[2]);
-        out_matrix[3] = row3_order(out_matrix[3]);
+        out_matrix[0] = duplex_permute(&mirror12, out_matrix[0]);
+        out_matrix[1] = duplex_permute(&mirror12, out_matrix[1]);
+        out_matrix[2] = duplex_permute(&mirror12, out_matrix[2]);
+        out_matrix[3] = duplex_permute(&row3_order, out_matrix[3]);
     }
 }
 
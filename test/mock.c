@@ -0,0 +1,201 @@
+// Mocks of QMK and hardware for host tests.  Functions which depend on
+// matrix_row_t are defined by each test, because its size varies.
+
+#include <stdio.h>
+#include "quantum.h"
+#include "spi_master.h"
+#include "transactions.h"
+#include "avr/sleep.h"
+#include "mock.h"
+
+uint32_t mock_now_us     = 0;
+bool     mock_pins[256]  = {0};
+bool     mock_is_master  = true;
+bool     mock_is_left    = false;
+bool     mock_connected  = true;
+uint16_t mock_spi_starts[256] = {0};
+uint8_t (*mock_spi_read_hook)(uint8_t addr) = NULL;
+void (*mock_sleep_hook)(void)               = NULL;
+uint16_t mock_sleeps                        = 0;
+
+static slave_callback_t rpc_handlers[MOCK_RPC_COUNT] = {0};
+
+static bool    spi_started = false;
+static uint8_t spi_addr    = 0;
+
+void mock_reset(void) {
+    mock_now_us = 0;
+    memset(mock_pins, 1, sizeof(mock_pins));
+    mock_is_master = true;
+    mock_is_left   = false;
+    mock_connected = true;
+    memset(mock_spi_starts, 0, sizeof(mock_spi_starts));
+    mock_spi_read_hook = NULL;
+    mock_sleep_hook    = NULL;
+    mock_sleeps        = 0;
+}
+
+void mock_advance_us(uint32_t us) {
+    mock_now_us += us;
+}
+
+// GPIO
+
+void setPinOutput(pin_t pin) {}
+void setPinInputHigh(pin_t pin) {}
+void writePinLow(pin_t pin) {}
+void writePinHigh(pin_t pin) {}
+
+bool readPin(pin_t pin) {
+    return mock_pins[pin];
+}
+
+// Timer
+
+void wait_us(uint16_t us) {
+    mock_now_us += us;
+}
+
+void wait_ms(uint16_t ms) {
+    mock_now_us += ms * 1000u;
+}
+
+uint16_t timer_read(void) {
+    return mock_now_us / 1000;
+}
+
+uint32_t timer_read32(void) {
+    return mock_now_us / 1000;
+}
+
+uint16_t timer_elapsed(uint16_t last) {
+    return TIMER_DIFF_16(timer_read(), last);
+}
+
+// SPI: the first byte of a transaction is the address.
+
+void spi_init(void) {}
+
+bool spi_start(pin_t slave_pin, bool lsb_first, uint8_t mode, uint16_t divisor) {
+    spi_started = true;
+    return true;
+}
+
+spi_status_t spi_write(uint8_t data) {
+    if (spi_started) {
+        spi_started = false;
+        spi_addr    = data;
+        mock_spi_starts[data]++;
+    }
+    return 0;
+}
+
+spi_status_t spi_read(void) {
+    return mock_spi_read_hook ? mock_spi_read_hook(spi_addr) : 0;
+}
+
+spi_status_t spi_transmit(const uint8_t *data, uint16_t length) {
+    return 0;
+}
+
+spi_status_t spi_receive(uint8_t *data, uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        data[i] = spi_read();
+    }
+    return 0;
+}
+
+void spi_stop(void) {
+    spi_started = false;
+}
+
+// Split transport: RPC calls the handler of the secondary directly.
+
+void transaction_register_rpc(int8_t id, slave_callback_t callback) {
+    rpc_handlers[id] = callback;
+}
+
+bool transaction_rpc_exec(int8_t id, uint8_t in_len, const void *in_data, uint8_t out_len, void *out_data) {
+    if (!mock_connected || rpc_handlers[id] == NULL) {
+        return false;
+    }
+    rpc_handlers[id](in_len, in_data, out_len, out_data);
+    return true;
+}
+
+bool is_transport_connected(void) {
+    return mock_connected;
+}
+
+// Sleep
+
+void set_sleep_mode(int mode) {}
+void sleep_enable(void) {}
+void sleep_disable(void) {}
+
+void sleep_cpu(void) {
+    mock_sleeps++;
+    if (mock_sleep_hook) {
+        mock_sleep_hook();
+    } else {
+        mock_now_us = (mock_now_us / 1000 + 1) * 1000;
+    }
+}
+
+// Keyboard
+
+bool is_keyboard_master(void) {
+    return mock_is_master;
+}
+
+__attribute__((weak)) bool is_keyboard_left(void) {
+    return mock_is_left;
+}
+
+void keyboard_pre_init_user(void) {}
+void keyboard_post_init_user(void) {}
+void housekeeping_task_user(void) {}
+void matrix_scan_kb(void) {}
+void matrix_io_delay(void) {}
+void matrix_output_select_delay(void) {}
+void matrix_output_unselect_delay(uint8_t line, bool key_pressed) {}
+
+bool process_record_user(uint16_t keycode, keyrecord_t *record) {
+    return true;
+}
+
+uint16_t bitrev16(uint16_t bits) {
+    uint16_t r = 0;
+    for (uint8_t i = 0; i < 16; i++, bits >>= 1) {
+        r = (r << 1) | (bits & 1);
+    }
+    return r;
+}
+
+bool eeconfig_is_enabled(void) {
+    return false;
+}
+
+uint32_t eeconfig_read_kb(void) {
+    return 0;
+}
+
+void eeconfig_update_kb(uint32_t val) {}
+
+bool layer_state_is(uint8_t layer) {
+    return false;
+}
+
+report_mouse_t pointing_device_task_user(report_mouse_t mouse_report) {
+    return mouse_report;
+}
+
+void register_mouse(uint8_t mouse_keycode, bool pressed) {}
+
+void oled_write_P(const char *data, bool invert) {}
+void oled_write(const char *data, bool invert) {}
+void oled_write_char(char data, bool invert) {}
+
+bool oled_task_user(void) {
+    return true;
+}
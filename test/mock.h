@@ -0,0 +1,29 @@
+// Mocks of QMK and hardware for host tests.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Time in microseconds, which wait_us() and wait_ms() advance.
+extern uint32_t mock_now_us;
+
+// Levels of pins, indexed by pin_t.  All pins are high initially.
+extern bool mock_pins[256];
+
+extern bool mock_is_master;
+extern bool mock_is_left;
+extern bool mock_connected;
+
+// Count of SPI transactions which start by each address byte, and hooks
+// which fill bytes read by spi_read() and spi_receive().
+extern uint16_t mock_spi_starts[256];
+extern uint8_t (*mock_spi_read_hook)(uint8_t addr);
+
+// mock_sleep_hook is called by sleep_cpu().  By default it advances time
+// to the next timer interrupt at a millisecond boundary.
+extern void (*mock_sleep_hook)(void);
+extern uint16_t mock_sleeps;
+
+void mock_reset(void);
+void mock_advance_us(uint32_t us);
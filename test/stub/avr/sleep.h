@@ -0,0 +1,8 @@
+#pragma once
+
+#define SLEEP_MODE_IDLE 0
+
+void set_sleep_mode(int mode);
+void sleep_enable(void);
+void sleep_cpu(void);
+void sleep_disable(void);
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "quantum.h"
+
+void debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed);
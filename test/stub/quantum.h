@@ -0,0 +1,192 @@
+// Host stub of QMK's quantum.h, which declares only what keyball uses.
+// Mocks are in ../mock.c, and tests control them by ../mock.h.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef F_CPU
+#    define F_CPU 16000000UL
+#endif
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define _BV(b) (1u << (b))
+#define ISR(v) void v(void)
+#define ATOMIC_BLOCK_FORCEON for (int atomic_once_ = 1; atomic_once_; atomic_once_ = 0)
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// Configurations of a keyboard, which tests may define before this.
+#define OLED_ENABLE // Keyball always has OLED
+#ifndef PRODUCT_ID
+#    define PRODUCT_ID 0x0200 // Keyball39
+#endif
+#ifndef MATRIX_ROWS
+#    define MATRIX_ROWS 8
+#    define MATRIX_COLS 6
+#    define MATRIX_ROW_PINS \
+        { F4, F5, F6, F7 }
+#    define MATRIX_COL_PINS \
+        { D4, C6, D7, E6, B4, B5 }
+#endif
+
+#if MATRIX_COLS <= 8
+typedef uint8_t matrix_row_t;
+#elif MATRIX_COLS <= 16
+typedef uint16_t matrix_row_t;
+#else
+typedef uint32_t matrix_row_t;
+#endif
+
+// GPIO: pins are indexes of mock_pins.
+typedef uint8_t pin_t;
+#define B4 0x34
+#define B5 0x35
+#define B6 0x36
+#define C6 0x46
+#define D0 0x50
+#define D1 0x51
+#define D2 0x52
+#define D4 0x54
+#define D7 0x57
+#define E6 0x66
+#define F4 0x74
+#define F5 0x75
+#define F6 0x76
+#define F7 0x77
+#define NO_PIN 0xFF
+
+void setPinOutput(pin_t pin);
+void setPinInputHigh(pin_t pin);
+void writePinLow(pin_t pin);
+void writePinHigh(pin_t pin);
+bool readPin(pin_t pin);
+
+void wait_us(uint16_t us);
+void wait_ms(uint16_t ms);
+
+uint16_t timer_read(void);
+uint32_t timer_read32(void);
+uint16_t timer_elapsed(uint16_t last);
+#define TIMER_DIFF_16(a, b) ((uint16_t)((a) - (b)))
+#define TIMER_DIFF_32(a, b) ((uint32_t)((a) - (b)))
+
+#define dprintf(...) ((void)0)
+
+// Keyboard
+typedef struct {
+    uint8_t col;
+    uint8_t row;
+} keypos_t;
+
+typedef struct {
+    keypos_t key;
+    bool     pressed;
+    uint16_t time;
+} keyevent_t;
+
+typedef struct {
+    keyevent_t event;
+} keyrecord_t;
+
+bool is_keyboard_master(void);
+bool is_keyboard_left(void);
+void keyboard_pre_init_user(void);
+void keyboard_post_init_user(void);
+bool process_record_user(uint16_t keycode, keyrecord_t *record);
+void housekeeping_task_user(void);
+void matrix_scan_kb(void);
+void matrix_slave_scan_user(void);
+void matrix_output_select_delay(void);
+void matrix_output_unselect_delay(uint8_t line, bool key_pressed);
+matrix_row_t matrix_get_row(uint8_t row);
+uint16_t bitrev16(uint16_t bits);
+
+bool     eeconfig_is_enabled(void);
+uint32_t eeconfig_read_kb(void);
+void     eeconfig_update_kb(uint32_t val);
+
+typedef uint32_t layer_state_t;
+bool layer_state_is(uint8_t layer);
+
+// Keycodes
+#define QK_KB_0 0x7E00
+#define QK_KB_1 0x7E01
+#define QK_KB_2 0x7E02
+#define QK_KB_3 0x7E03
+#define QK_KB_4 0x7E04
+#define QK_KB_5 0x7E05
+#define QK_KB_6 0x7E06
+#define QK_KB_7 0x7E07
+#define QK_KB_8 0x7E08
+#define QK_KB_9 0x7E09
+#define QK_KB_10 0x7E0A
+#define QK_KB_11 0x7E0B
+#define QK_KB_12 0x7E0C
+#define QK_KB_13 0x7E0D
+#define QK_KB_14 0x7E0E
+#define QK_KB_15 0x7E0F
+#define QK_KB_16 0x7E10
+#define QK_KB_17 0x7E11
+#define QK_KB_18 0x7E12
+#define QK_KB_19 0x7E13
+#define QK_KB_20 0x7E14
+#define QK_KB_21 0x7E15
+#define QK_KB_22 0x7E16
+#define QK_KB_23 0x7E17
+#define QK_KB_24 0x7E18
+#define QK_KB_25 0x7E19
+#define QK_KB_26 0x7E1A
+#define QK_KB_27 0x7E1B
+#define QK_KB_28 0x7E1C
+#define QK_KB_29 0x7E1D
+#define QK_KB_30 0x7E1E
+#define QK_KB_31 0x7E1F
+#define QK_USER_0 0x7E40
+#define KC_A 0x0004
+#define QK_MODS 0x0100
+#define QK_MODS_MAX 0x1FFF
+#define KC_MS_BTN1 0x00CD
+#define KC_MS_BTN8 0x00D4
+
+// Pointing device
+#ifdef MOUSE_EXTENDED_REPORT
+typedef int16_t mouse_xy_report_t;
+#else
+typedef int8_t mouse_xy_report_t;
+#endif
+
+#ifdef MOUSE_SCROLL_EXTENDED_REPORT
+typedef int16_t mouse_hv_report_t;
+#else
+typedef int8_t mouse_hv_report_t;
+#endif
+
+typedef struct {
+    uint8_t           buttons;
+    mouse_xy_report_t x;
+    mouse_xy_report_t y;
+    mouse_hv_report_t v;
+    mouse_hv_report_t h;
+} report_mouse_t;
+
+report_mouse_t pointing_device_task_user(report_mouse_t mouse_report);
+void           register_mouse(uint8_t mouse_keycode, bool pressed);
+
+// Split
+bool is_transport_connected(void);
+
+// OLED
+void oled_write_P(const char *data, bool invert);
+void oled_write(const char *data, bool invert);
+void oled_write_char(char data, bool invert);
+bool oled_task_user(void);
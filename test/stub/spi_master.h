@@ -0,0 +1,13 @@
+#pragma once
+
+#include "quantum.h"
+
+typedef int16_t spi_status_t;
+
+void         spi_init(void);
+bool         spi_start(pin_t slave_pin, bool lsb_first, uint8_t mode, uint16_t divisor);
+spi_status_t spi_write(uint8_t data);
+spi_status_t spi_read(void);
+spi_status_t spi_transmit(const uint8_t *data, uint16_t length);
+spi_status_t spi_receive(uint8_t *data, uint16_t length);
+void         spi_stop(void);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "quantum.h"
+
+extern volatile bool isLeftHand;
+
+void split_pre_init(void);
+void split_post_init(void);
+bool transport_master_if_connected(matrix_row_t master_matrix[], matrix_row_t slave_matrix[]);
+void transport_slave(matrix_row_t master_matrix[], matrix_row_t slave_matrix[]);
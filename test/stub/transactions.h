@@ -0,0 +1,16 @@
+#pragma once
+
+#include "quantum.h"
+
+// IDs of RPC, which are defined by SPLIT_TRANSACTION_IDS_KB in config.h.
+enum {
+    KEYBALL_GET_INFO,
+    KEYBALL_GET_MOTION,
+    KEYBALL_SYNC_STATE,
+    MOCK_RPC_COUNT,
+};
+
+typedef void (*slave_callback_t)(uint8_t initiator2target_buffer_size, const void *initiator2target_buffer, uint8_t target2initiator_buffer_size, void *target2initiator_buffer);
+
+void transaction_register_rpc(int8_t transaction_id, slave_callback_t callback);
+bool transaction_rpc_exec(int8_t transaction_id, uint8_t initiator2target_buffer_size, const void *initiator2target_buffer, uint8_t target2initiator_buffer_size, void *target2initiator_buffer);
@@ -0,0 +1,31 @@
+// Minimal assertions for host tests.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                 \
+        }                                                                    \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                    \
+    do {                                                                                                  \
+        long long a_ = (long long)(a), b_ = (long long)(b);                                               \
+        if (a_ != b_) {                                                                                   \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s (%lld) != %s (%lld)\n", __FILE__, __LINE__, #a, a_, #b, b_); \
+            test_failures++;                                                                              \
+        }                                                                                                 \
+    } while (0)
+
+#define TEST_DONE()                                             \
+    do {                                                        \
+        printf("%s: %s\n", __BASE_FILE__, test_failures ? "FAIL" : "ok"); \
+        return test_failures ? 1 : 0;                           \
+    } while (0)
@@ -0,0 +1,85 @@
+// Motion which exceeds a mouse report is carried over to
+// following reports, so no count is lost.
+
+#define KEYBALL_MOTION_CARRYOVER
+
+#include "quantum.h"
+#include "lib/keyball/keyball.c"
+#include "drivers/pmw3360/pmw3360.c"
+#include "mock.h"
+#include "test.h"
+
+typedef struct {
+    int32_t x, y, h, v;
+} sum_t;
+
+// feed adds a motion of the sensor, as a burst read does.
+static void feed(int16_t x, int16_t y) {
+    pmw3360_burst_t d = {.mot = pmw3360_MOT, .x = x, .y = y};
+    add_this_motion(0, &d);
+}
+
+// run_ms runs passes of the main loop for each millisecond, and sums up
+// mouse reports.
+static void run_ms(uint16_t n, sum_t *s) {
+    for (uint16_t i = 0; i < n; i++) {
+        mock_advance_us(1000);
+        report_mouse_t r = pointing_device_driver_get_report((report_mouse_t){0});
+        s->x += r.x;
+        s->y += r.y;
+        s->h += r.h;
+        s->v += r.v;
+    }
+}
+
+// replay feeds a fast trace: flicks up to 600 counts per millisecond.
+static void replay(int32_t *tx, int32_t *ty, sum_t *s) {
+    uint32_t seed = 1;
+    for (uint16_t i = 0; i < 300; i++) {
+        seed      = seed * 1103515245 + 12345;
+        int16_t x = (int16_t)((seed >> 16) % 1201) - 600;
+        int16_t y = (int16_t)(i < 100 ? 200 : i < 200 ? 0 : -150);
+        feed(x, y);
+        *tx += x;
+        *ty += y;
+        run_ms(1, s);
+    }
+}
+
+int main(void) {
+    mock_reset();
+    // this side has the ball, then it moves the pointer.
+    keyball.this_have_ball = true;
+    mock_advance_us(KEYBALL_SCROLLBALL_INHIVITOR * 1000);
+
+    // move: Keyball39 on right side reports x by y of the sensor.
+    {
+        sum_t   s  = {0};
+        int32_t tx = 0, ty = 0;
+        replay(&tx, &ty, &s);
+        run_ms(2000, &s);
+        CHECK_EQ(s.y, tx);
+        CHECK_EQ(s.x, ty);
+        CHECK_EQ(keyball.this_motion.x, 0);
+        CHECK_EQ(keyball.this_motion.y, 0);
+    }
+
+    // scroll: all counts are reported as scroll, except the remainder of
+    // the scroll divider.
+    {
+        keyball_set_scroll_mode(true);
+        keyball_set_scrollsnap_mode(KEYBALL_SCROLLSNAP_MODE_FREE);
+        mock_advance_us(KEYBALL_SCROLLBALL_INHIVITOR * 1000);
+        sum_t   s   = {0};
+        int32_t tx  = 0, ty = 0;
+        int16_t div = 1 << (keyball_get_scroll_div() - 1);
+        replay(&tx, &ty, &s);
+        run_ms(2000, &s);
+        CHECK_EQ(-s.v * div + keyball.this_motion.x, tx);
+        CHECK_EQ(s.h * div + keyball.this_motion.y, ty);
+        CHECK(abs(keyball.this_motion.x) < div);
+        CHECK(abs(keyball.this_motion.y) < div);
+    }
+
+    TEST_DONE();
+}
@@ -0,0 +1,5 @@
+// Carry-over with 16-bit mouse reports.
+
+#define MOUSE_EXTENDED_REPORT
+
+#include "test_carryover.c"
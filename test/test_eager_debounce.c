@@ -0,0 +1,107 @@
+// Eager debounce reports a press at once and a release after
+// DEBOUNCE milliseconds of no bounce.  matrix_scan() tells only changes of
+// the debounced matrix.
+
+#define MATRIX_ROWS 4
+#define MATRIX_COLS 12
+#define MATRIX_ROW_PINS \
+    { F4, F5, F6, F7 }
+#define MATRIX_COL_PINS \
+    { D2, D4, C6, D7, E6, B4 }
+#define DUPLEX_MATRIX_EAGER_DEBOUNCE
+#define DEBOUNCE 5
+// the motion flag of Keyball on the key under test, but in another row.
+#define KEYBALL_MOTION_FLAG_ROW 1
+#define KEYBALL_MOTION_FLAG_COL 0
+
+#include "quantum.h"
+#include "lib/duplexmatrix/duplexmatrix.c"
+#include "mock.h"
+#include "test.h"
+
+// the matrix of QMK, which duplexmatrix.c refers.
+matrix_row_t raw_matrix[MATRIX_ROWS];
+matrix_row_t matrix[MATRIX_ROWS];
+
+void debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed) {}
+
+typedef struct {
+    uint16_t changes; // scans which tell a change
+} stats_t;
+
+// contact is the raw state of a key on the first column.  Mocks of pins
+// can't select a row, so the scan sees it on all rows.
+static bool contact = false;
+
+// scan_ms scans the matrix once after a millisecond.
+static void scan_ms(stats_t *s) {
+    mock_advance_us(1000);
+    mock_pins[D2] = !contact;
+    if (matrix_scan()) {
+        s->changes++;
+    }
+}
+
+// bounce toggles contact at each millisecond for n milliseconds, then it
+// settles to the final state.
+static void bounce(stats_t *s, uint8_t n, bool final) {
+    for (uint8_t i = 0; i < n; i++) {
+        contact = !contact;
+        scan_ms(s);
+    }
+    contact = final;
+}
+
+static bool pressed(void) {
+    return (matrix[0] & 1) != 0;
+}
+
+int main(void) {
+    mock_reset();
+    matrix_init_custom();
+    stats_t s = {0};
+
+    // a bouncy press is reported at the first contact, and bounces while it
+    // is held are absorbed.
+    contact = true;
+    scan_ms(&s);
+    CHECK(pressed());
+    // the position of the motion flag is skipped.
+    CHECK_EQ(matrix[KEYBALL_MOTION_FLAG_ROW], 0);
+    CHECK_EQ(matrix[2], 1);
+    bounce(&s, 3, true);
+    CHECK(pressed());
+    for (uint8_t i = 0; i < 20; i++) {
+        scan_ms(&s);
+        CHECK(pressed());
+    }
+
+    // a bouncy release is reported DEBOUNCE ms after the last bounce.
+    bounce(&s, 4, false);
+    for (uint8_t i = 0; i < DEBOUNCE - 1; i++) {
+        scan_ms(&s);
+        CHECK(pressed());
+    }
+    scan_ms(&s);
+    CHECK(!pressed());
+
+    // only the press and the release are changes, not each bounce.
+    CHECK_EQ(s.changes, 2);
+
+    // after a long gap of scans, a release is still debounced in full.
+    mock_advance_us(100000);
+    scan_ms(&s);
+    contact = true;
+    scan_ms(&s);
+    CHECK(pressed());
+    contact = false;
+    for (uint8_t i = 0; i < DEBOUNCE - 1; i++) {
+        scan_ms(&s);
+        CHECK(pressed());
+    }
+    scan_ms(&s);
+    CHECK(!pressed());
+    CHECK_EQ(s.changes, 4);
+
+    TEST_DONE();
+}
@@ -0,0 +1,122 @@
+// Handoff of motion from the main loop to the split RPC handler
+// loses no count and no motion flag, wherever the handler preempts the main
+// loop.  handoff_put() is single-stepped by the trap flag of x86-64, and the
+// handler is injected after each of its instructions in turn, as the serial
+// interrupt may do.
+
+#define _GNU_SOURCE
+#define SPLIT_KEYBOARD
+#define KEYBALL_MOTION_SCROLL
+#define KEYBALL_MOTION_PACING
+
+#include <signal.h>
+
+#include "quantum.h"
+#include "lib/keyball/keyball.c"
+#include "drivers/pmw3360/pmw3360.c"
+#include "mock.h"
+#include "test.h"
+
+#ifdef __x86_64__
+
+typedef struct {
+    int64_t x, y, h, v;
+} sum_t;
+
+static sum_t             recv_sum;
+static volatile uint16_t steps;  // instructions stepped in this put
+static volatile uint16_t inject; // instruction to inject the handler after
+
+// get_motion runs the handler as the primary invokes it.
+static void get_motion(void) {
+    keyball_motion_packet_t p = {0};
+    rpc_get_motion_handler(0, NULL, sizeof(p), &p);
+    recv_sum.x += p.x;
+    recv_sum.y += p.y;
+    recv_sum.h += p.h;
+    recv_sum.v += p.v;
+}
+
+// on_trap fetches motion while the flag is raised, as the primary does.
+static void on_trap(int sig, siginfo_t *si, void *uc) {
+    if (steps++ == inject && handoff_pending()) {
+        get_motion();
+    }
+}
+
+static void put(int16_t x, int16_t y, int16_t h, int16_t v) {
+    steps = 0;
+    __asm__ volatile("pushfq; orq $0x100, (%%rsp); popfq" ::: "memory", "cc");
+    handoff_put(x, y, h, v);
+    __asm__ volatile("pushfq; andq $~0x100, (%%rsp); popfq" ::: "memory", "cc");
+}
+
+static bool same(const sum_t *s) {
+    return recv_sum.x == s->x && recv_sum.y == s->y && recv_sum.h == s->h && recv_sum.v == s->v;
+}
+
+int main(void) {
+    mock_reset();
+    mock_is_master = false;
+    struct sigaction sa = {.sa_sigaction = on_trap, .sa_flags = SA_SIGINFO};
+    sigaction(SIGTRAP, &sa, NULL);
+
+    // count instructions of a put.
+    inject = UINT16_MAX;
+    put(0, 0, 0, 0);
+    uint16_t n = steps;
+    CHECK(n > 10);
+    while (handoff_pending()) {
+        get_motion();
+    }
+    recv_sum = (sum_t){0};
+
+    sum_t    sent = {0};
+    uint32_t seed = 1;
+    uint16_t lost = 0;
+    for (uint16_t round = 0; round < 20; round++) {
+        for (inject = 0; inject < n; inject++) {
+            seed = seed * 1103515245 + 12345;
+            // mostly slow motion, with flicks which exceed a packet.
+            int16_t x = (seed >> 24) == 0 ? 300 : (seed >> 24) == 1 ? -300 : (int16_t)((seed >> 8) % 9) - 4;
+            int16_t y = (int16_t)((seed >> 16) % 5) - 2;
+            int16_t h = (int16_t)(seed % 3) - 1;
+            int16_t v = (int16_t)((seed >> 4) % 5) - 2;
+            put(x, y, h, v);
+            mock_advance_us(1000);
+            sent.x += x;
+            sent.y += y;
+            sent.h += h;
+            sent.v += v;
+            // motion which is left must keep the flag raised.
+            if (!handoff_pending() && !same(&sent)) {
+                lost++;
+            }
+            // the primary fetches it sometimes between puts.
+            if ((seed & 3) == 0) {
+                while (handoff_pending()) {
+                    get_motion();
+                }
+            }
+        }
+    }
+    while (handoff_pending()) {
+        get_motion();
+    }
+    CHECK_EQ(lost, 0);
+    CHECK_EQ(recv_sum.x, sent.x);
+    CHECK_EQ(recv_sum.y, sent.y);
+    CHECK_EQ(recv_sum.h, sent.h);
+    CHECK_EQ(recv_sum.v, sent.v);
+
+    TEST_DONE();
+}
+
+#else
+
+int main(void) {
+    printf("%s: skipped, single-stepping needs x86-64\n", __BASE_FILE__);
+    return 0;
+}
+
+#endif
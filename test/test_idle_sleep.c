@@ -0,0 +1,92 @@
+// The CPU sleeps between passes of the main loop after KEYBALL_IDLE_SLEEP of
+// no activity, and a pass after the timer tick sees a key which is pressed
+// while sleeping.
+
+#define __AVR__
+#define KEYBALL_IDLE_SLEEP 1000
+
+#include "quantum.h"
+#include "lib/keyball/keyball.c"
+#include "drivers/pmw3360/pmw3360.c"
+#include "mock.h"
+#include "test.h"
+
+// PASS_US is time which a pass of the main loop takes without sleeping.
+#define PASS_US 200
+
+static matrix_row_t held       = 0;
+static uint32_t     press_at   = UINT32_MAX;
+static uint32_t     pressed_at = 0; // time which a pass has seen the press
+
+matrix_row_t matrix_get_row(uint8_t row) {
+    return row == 0 ? held : 0;
+}
+
+// scan presses a key at press_at, as the matrix scan of a pass sees.
+static void scan(void) {
+    if (held == 0 && mock_now_us >= press_at) {
+        held       = 1;
+        pressed_at = mock_now_us;
+    }
+}
+
+// run_ms runs passes of the main loop for n milliseconds, and returns count
+// of sleeps.
+static uint16_t run_ms(uint16_t n) {
+    uint16_t before = mock_sleeps;
+    uint32_t until  = mock_now_us + n * 1000u;
+    while (mock_now_us < until) {
+        scan();
+        pointing_device_driver_get_report((report_mouse_t){0});
+        housekeeping_task_kb();
+        mock_advance_us(PASS_US);
+    }
+    return mock_sleeps - before;
+}
+
+int main(void) {
+    mock_reset();
+    mock_is_master       = true;
+    ball_ready           = 1;
+    keyball.this_booting = false;
+    idle_touch();
+
+    // no sleep until KEYBALL_IDLE_SLEEP passes, then sleep at each pass.
+    CHECK_EQ(run_ms(KEYBALL_IDLE_SLEEP - 10), 0);
+    run_ms(20);
+    uint16_t sleeps = run_ms(100);
+    CHECK(sleeps >= 80);
+
+    // a held key keeps awake, and KEYBALL_IDLE_SLEEP restarts by release.
+    held = 1;
+    CHECK_EQ(run_ms(2000), 0);
+    held = 0;
+    CHECK_EQ(run_ms(KEYBALL_IDLE_SLEEP - 10), 0);
+    run_ms(20);
+    CHECK(run_ms(100) >= 80);
+
+    // motion of the ball keeps awake too.
+    pmw3360_burst_t d = {.mot = pmw3360_MOT, .x = 1, .y = 0};
+    add_this_motion(0, &d);
+    CHECK_EQ(run_ms(KEYBALL_IDLE_SLEEP - 10), 0);
+    run_ms(20);
+    CHECK(run_ms(100) >= 80);
+
+    // a key pressed while sleeping is seen by the pass after the next tick,
+    // then sleep stops at once.
+    for (uint16_t offset = 0; offset < 1000; offset += 50) {
+        held     = 0;
+        press_at = mock_now_us - mock_now_us % 1000 + 5000 + offset;
+        CHECK(run_ms(10) > 0);
+        CHECK(held != 0);
+        CHECK(pressed_at - press_at <= 1000 + PASS_US);
+        uint16_t after = mock_sleeps;
+        run_ms(KEYBALL_IDLE_SLEEP - 10);
+        CHECK_EQ(mock_sleeps, after);
+        held     = 0;
+        press_at = UINT32_MAX;
+        run_ms(KEYBALL_IDLE_SLEEP + 10);
+    }
+
+    TEST_DONE();
+}
@@ -0,0 +1,64 @@
+// Kinetic scroll starts when the ball is released quickly, even
+// if the scroll divider leaves a remainder.
+
+#define KEYBALL_KINETIC_SCROLL_ENABLE
+
+#include "quantum.h"
+#include "lib/keyball/keyball.c"
+#include "drivers/pmw3360/pmw3360.c"
+#include "mock.h"
+#include "test.h"
+
+static void feed(int16_t x, int16_t y) {
+    pmw3360_burst_t d = {.mot = pmw3360_MOT, .x = x, .y = y};
+    add_this_motion(0, &d);
+}
+
+// run_ms runs passes of the main loop for each millisecond, and returns
+// count of reports which scroll.
+static uint16_t run_ms(uint16_t n, int16_t y) {
+    uint16_t scrolls = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        if (y != 0) {
+            feed(0, y);
+        }
+        mock_advance_us(1000);
+        report_mouse_t r = pointing_device_driver_get_report((report_mouse_t){0});
+        if (r.h != 0 || r.v != 0) {
+            scrolls++;
+        }
+    }
+    return scrolls;
+}
+
+int main(void) {
+    mock_reset();
+    keyball.this_have_ball = true;
+    keyball_set_scroll_mode(true);
+    keyball_set_scrollsnap_mode(KEYBALL_SCROLLSNAP_MODE_FREE);
+    mock_advance_us(KEYBALL_SCROLLBALL_INHIVITOR * 1000);
+
+    // 3 counts per millisecond leaves a remainder of the divider (8).
+    CHECK(run_ms(100, 3) > 0);
+    CHECK(keyball.this_motion.y != 0);
+    // released: scroll continues, then stops.
+    CHECK(run_ms(80, 0) >= 8);
+    CHECK(run_ms(5000, 0) > 0);
+    CHECK(!kinetic_this.coasting);
+    CHECK_EQ(run_ms(100, 0), 0);
+
+    // slow motion doesn't start kinetic scroll.
+    run_ms(100, 1);
+    run_ms(16, 0);
+    CHECK(!kinetic_this.coasting);
+
+    // a key press stops kinetic scroll.
+    run_ms(100, 3);
+    run_ms(16, 0);
+    CHECK(kinetic_this.coasting);
+    process_record_kb(KC_A, &(keyrecord_t){.event = {.pressed = true}});
+    CHECK(!kinetic_this.coasting);
+    CHECK_EQ(run_ms(100, 0), 0);
+
+    TEST_DONE();
+}
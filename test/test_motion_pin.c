@@ -0,0 +1,61 @@
+// The sensor is read only while its MOTION pin is low.
+
+#define PMW3360_MOTION_PIN D1
+
+#include "quantum.h"
+#include "lib/keyball/keyball.c"
+#include "drivers/pmw3360/pmw3360.c"
+#include "mock.h"
+#include "test.h"
+
+// burst_byte returns bytes of Motion_Burst, which has motion of (3, -2).
+static uint8_t burst_byte(uint8_t addr) {
+    static const uint8_t data[] = {0x80, 0, 3, 0, 0xfe, 0xff, 0x40};
+    static uint16_t      starts = 0;
+    static uint8_t       index  = 0;
+    if (addr != pmw3360_Motion_Burst) {
+        return 0;
+    }
+    if (starts != mock_spi_starts[pmw3360_Motion_Burst]) {
+        starts = mock_spi_starts[pmw3360_Motion_Burst];
+        index  = 0;
+    }
+    return index < sizeof(data) ? data[index++] : 0;
+}
+
+// run_passes runs passes of the main loop for each millisecond, and returns
+// count of Motion_Burst reads.
+static uint16_t run_passes(uint16_t n) {
+    uint16_t before = mock_spi_starts[pmw3360_Motion_Burst];
+    for (uint16_t i = 0; i < n; i++) {
+        mock_advance_us(1000);
+        pointing_device_driver_get_report((report_mouse_t){0});
+    }
+    return mock_spi_starts[pmw3360_Motion_Burst] - before;
+}
+
+int main(void) {
+    mock_reset();
+    mock_spi_read_hook = burst_byte;
+    // the sensor has booted.
+    ball_ready           = 1;
+    keyball.this_booting = false;
+
+    // no motion: MOTION pin is high, the sensor is never read.
+    mock_pins[D1] = true;
+    CHECK_EQ(run_passes(1000), 0);
+    CHECK_EQ(keyball.this_motion.x, 0);
+
+    // motion: the sensor is read at each pass while MOTION pin is low.
+    mock_pins[D1] = false;
+    CHECK_EQ(run_passes(1), 1);
+    CHECK_EQ(keyball.this_motion.x, 3);
+    CHECK_EQ(keyball.this_motion.y, -2);
+    CHECK_EQ(run_passes(99), 99);
+
+    // motion is read entirely, MOTION pin goes high again.
+    mock_pins[D1] = true;
+    CHECK_EQ(run_passes(1000), 0);
+
+    TEST_DONE();
+}
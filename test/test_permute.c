@@ -0,0 +1,69 @@
+// Permutation tables of ONE47 for the left ball match the functions which
+// they replaced, for all inputs of 12 columns.
+
+#define MATRIX_ROWS 4
+#define MATRIX_COLS 12
+#define MATRIX_ROW_PINS \
+    { F4, F5, F6, F7 }
+#define MATRIX_COL_PINS \
+    { D2, D4, C6, D7, E6, B4 }
+#define QMK_KEYBOARD_H "quantum.h"
+
+#include "quantum.h"
+// rename the weak default of duplexmatrix.c, which ONE47 overrides.
+#define duplex_scan_raw_post_kb duplex_scan_raw_post_kb_default
+#include "lib/duplexmatrix/duplexmatrix.c"
+#undef duplex_scan_raw_post_kb
+#include "one47/one47.c"
+#include "mock.h"
+#include "test.h"
+
+// the matrix of QMK, which duplexmatrix.c refers.
+matrix_row_t raw_matrix[MATRIX_ROWS];
+matrix_row_t matrix[MATRIX_ROWS];
+
+void debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed) {}
+
+// Functions of ONE47 before the permutation tables.
+
+static const uint8_t row3_order_data[] = {0, 1, 2, 3, 9, 8, 7, 6, 5, 4, 10};
+
+static uint16_t old_bitrev12(uint16_t bits) {
+    return bitrev16(bits) >> 4;
+}
+
+static uint16_t old_row3_order(uint16_t bits) {
+    uint16_t r = 0;
+    for (int i = 0; i < sizeof(row3_order_data) / sizeof(row3_order_data[0]); i++) {
+        uint8_t shift = row3_order_data[i];
+        r |= ((bits & (1 << shift)) >> shift) << i;
+    }
+    return r;
+}
+
+int main(void) {
+    mock_reset();
+
+    isLeftBall = true;
+    for (uint16_t bits = 0; bits < 0x1000; bits++) {
+        matrix_row_t m[MATRIX_ROWS] = {bits, bits, bits, bits};
+        duplex_scan_raw_post_kb(m);
+        CHECK_EQ(m[0], old_bitrev12(bits));
+        CHECK_EQ(m[1], old_bitrev12(bits));
+        CHECK_EQ(m[2], old_bitrev12(bits));
+        CHECK_EQ(m[3], old_row3_order(bits));
+        if (test_failures != 0) {
+            fprintf(stderr, "bits=0x%03x\n", bits);
+            break;
+        }
+    }
+
+    // the right ball has no permutation.
+    isLeftBall = false;
+    matrix_row_t m[MATRIX_ROWS] = {0x123, 0x456, 0x789, 0xabc};
+    duplex_scan_raw_post_kb(m);
+    CHECK_EQ(m[0], 0x123);
+    CHECK_EQ(m[3], 0xabc);
+
+    TEST_DONE();
+}